@@ -23,6 +23,7 @@ static const int rankStep = rank2 - rank1;
 static const int fileStep = fileB - fileA;
 
 typedef struct Board *Board_t;
+typedef struct Vector *Vector_t;
 
 struct side {
         unsigned char attacks[boardSize];
@@ -48,6 +49,35 @@ enum {
 #define maxMoveSize sizeof("a7-a8=N+")
 #define maxFenSize 128
 
+/*
+ *  Evaluation features for the futility margin model in search. Suffix
+ *  'X' is for the opponent of the side to move. The order must be the
+ *  same as for the model weights in params.h
+ */
+enum futilityFeature {
+        featureHanging_0, featureHanging_1, featureHanging_2, // Top-3 hanging piece values
+        featureHanging_0X, featureHanging_1X, featureHanging_2X,
+        featurePassers, featurePassersX,   // Number of passed pawns
+        featureKingZone, featureKingZoneX, // Number of attacked squares around the king
+        nrFutilityFeatures
+};
+
+/*
+ *  Sliders can walk over a copy of the board in 0x88 layout with a border
+ *  of sentinels around it, the mailbox, so that the edge stops them just
+ *  like a piece does. Select with -DmailboxSliders=0 or 1 when building.
+ *  With 0 the walks test the direction masks on the 8x8 board instead.
+ *  The mailbox costs a copy in each updateSideInfo, and it measured about
+ *  10% slower in perft and not faster in search, so it is off by default.
+ */
+#if !defined(mailboxSliders)
+ #define mailboxSliders 0
+#endif
+
+#define mailboxSize (16 * 10) // 8 files of 16 bytes, with a border file at either end
+#define mailboxIndex(square) ((square) + ((square) & ~7) + 17) // 0x88, and room for stepSW from a1
+#define mailboxBorder (-1)
+
 struct Board {
         signed char squares[boardSize];
         signed char castleFlags;
@@ -77,8 +107,15 @@ struct Board {
          */
         sByteList undoStack;
 
+        Vector_t vector; // Evaluation parameters and caches, null for the default vector
+
         int *movePtr; // Used only during move generation
         int futilityMargin; // Calculated by evaluate()
+        short futilityFeatures[nrFutilityFeatures]; // Also by evaluate(), for the search model
+        int materialPhase; // 0..3 for endgame .. opening, also by evaluate()
+#if mailboxSliders
+        signed char mailbox[mailboxSize]; // Updated with the side info
+#endif
 };
 
 /*
@@ -118,22 +155,40 @@ enum castleFlag {
  *  Move integer bits are as follows:
  *  0-5         to square
  *  6-11        from square
- *  12          special flag (castling, promotion, en passant capture, double pawn push)
- *  13-14       promotion: Q=0, R=1, B=2, N=3
+ *  12-14       tag: type of the moving piece, or the promotion piece
+ *
+ *  Castling, en passant captures and double pawn pushes don't have a
+ *  tag of their own: they follow from the tag and the geometry of the move.
  */
 
 #define boardBits 6
+#define tagBits (2*boardBits)
+
+enum moveTag {
+        movePawnTag,
+        moveKnightBishopRookTag,
+        moveQueenTag,
+        moveKingTag,
+        promoteBishopTag,
+        promoteRookTag,
+        promoteKnightTag,
+        promoteQueenTag
+};
 
 #define move(from, to)          (((from) << boardBits) | (to))
-enum moveFlags {
-        specialMoveFlag         = 1 << (2*boardBits),
-        promotionBits           = 2*boardBits + 1,
-        queenPromotionFlags     = 0 << promotionBits,
-        rookPromotionFlags      = 1 << promotionBits,
-        bishopPromotionFlags    = 2 << promotionBits,
-        knightPromotionFlags    = 3 << promotionBits
-};
-#define specialMove(from, to)   (specialMoveFlag | move(from, to))
+#define taggedMove(tag, from, to) (((tag) << tagBits) | move(from, to))
+
+#define moveTag(move)           (int) (((move) >> tagBits) & ones(3))
+
+/*
+ *  Move classes
+ */
+
+#define isPawnMove(move)        (moveTag(move) == movePawnTag)
+#define isPromotion(move)       (moveTag(move) >= promoteBishopTag)
+#define isPawnCapture(move)     (isPawnMove(move) && file(from(move)) != file(to(move)))
+#define isTacticalMove(board, move) \
+        ((board)->squares[to(move)] != empty || isPromotion(move) || isPawnCapture(move))
 
 #define from(move)              (int) (((move) >> boardBits) & ones(boardBits))
 #define to(move)                (int) ( (move)               & ones(boardBits))
@@ -181,15 +236,37 @@ uint64_t hash(Board_t self);
 uint64_t pawnKingHash(Board_t self);
 
 /*
- *  Generate all pseudo-legal moves for the position and return the move count
+ *  Prepare the tables for pawnKingHash and makeMove. Call once at startup,
+ *  before any board is set up.
  */
-int generateMoves(Board_t self, int moveList[maxMoves]);
+void initPawnKingHash(void);
+
+/*
+ *  Generate pseudo-legal moves for the position and return the move count
+ */
+enum generateMode {
+        generateAll,            // All pseudo-legal moves
+        generateQueening        // Drop the underpromotions, except knights that give check
+};
+int generateMoves(Board_t self, int moveList[maxMoves], int mode);
+
+/*
+ *  Underpromotion that is rarely better than queening: to rook or
+ *  bishop, or to a knight that doesn't give check. Needs updateSideInfo.
+ */
+bool isWeakUnderpromotion(Board_t self, int move);
 
 /*
  *  Make the move on the board
  */
 void makeMove(Board_t self, int move);
 
+/*
+ *  Hash of the position after the move, without making it. For looking
+ *  ahead in the transposition table. (See the definition for a caveat.)
+ */
+uint64_t hashAfterMove(Board_t self, int move);
+
 /*
  *  Check if last pseudo move was indeed legal
  */
@@ -217,6 +294,12 @@ void makeNullMove(Board_t self);
  */
 char *moveToUci(char moveString[maxMoveSize], int move);
 
+/*
+ *  Convert move to standard algebraic notation (SAN), with + or # for check
+ *  and mate. A movelist must be prepared by the caller for disambiguation.
+ */
+char *moveToSan(Board_t self, char moveString[maxMoveSize], int move, int xmoves[maxMoves], int xlen);
+
 /*
  *  Parse move input, disambiguate abbreviated notations
  *  A movelist must be prepared by the caller for disambiguation.
@@ -225,6 +308,11 @@ char *moveToUci(char moveString[maxMoveSize], int move);
  */
 extern int parseUciMove(Board_t self, const char *line, int xmoves[maxMoves], int xlen, int *move);
 
+/*
+ *  The same for standard algebraic notation (SAN), such as Nbd7 or exd8=Q+
+ */
+extern int parseSanMove(Board_t self, const char *line, int xmoves[maxMoves], int xlen, int *move);
+
 // Clear the ep flag if there are not legal moves
 extern void normalizeEnPassantStatus(Board_t self);
 
@@ -18,6 +18,7 @@
  +----------------------------------------------------------------------*/
 
 #define maxDepth 120
+#define onePly 4 // Search depth units per ply, for fractional extensions and reductions
 #define nrKillers 5
 #define newKillerIndex 2
 
@@ -30,8 +31,15 @@ typedef void searchInfo_fn(void *infoData);
  *  Transposition table
  */
 
-#define ttDepthBits 8
+#define ttDepthBits 10 // Depth in onePly units
 #define ttDateBits 12
+#define secondMovesLen 4096 // must be power of 2
+
+// Bucket replacement schemes, selected with the `Hash Policy' UCI option
+enum ttPolicy {
+        ttAgePolicy,     // Replace the lowest (-age, depth) in the bucket
+        ttTwoTierPolicy, // Depth-preferred slots with aging, plus always-replace slots
+};
 
 enum {
         minMate = -32000, minEval = -29999, minDtz  = -31000,
@@ -63,6 +71,35 @@ struct ttSlot {
 
 typedef Tuple(int, nrKillers) killersTuple;
 
+// Root move with its result and search effort in the last iteration
+struct rootMove {
+        int move;
+        int score;
+        long long nodeCount;
+};
+
+// Counters for analysing the search, reset at the start of each search
+struct searchStats {
+        long long rescues;    // Reduced moves researched because of an unexpectedly big subtree
+        long long rescueCuts; // ... of which then failed high
+        long long rootResearches; // Root moves searched again after failing high on a zero window
+        long long nullMoves;    // Null move searches
+        long long nullCuts;     // ... that failed high
+        long long nullConfirms; // Staged null move fail highs that needed a second search
+        long long futilityTests;  // Frontier nodes checked for futility
+        long long futilityPrunes; // ... found futile
+        long long futilityErrors; // ... that failed high anyway (only known when sampling)
+        long long deltaTests;  // Captures checked for delta pruning in quiescence search
+        long long deltaPrunes; // ... found futile
+        long long deltaErrors; // ... that failed high anyway (only known when sampling)
+        long long ttProbes;    // Transposition table reads
+        long long ttHits;      // ... that found the position
+        long long ttStores;    // Transposition table writes
+        long long ttEvictions; // ... that replaced another position from this search
+        long long etcTests;    // Nodes that looked up their children for a cutoff
+        long long etcCuts;     // ... and found one
+};
+
 #define ply(self) (board(self)->plyNumber - (self)->rootPlyNumber)
 
 /*
@@ -82,10 +119,17 @@ struct Engine {
                 size_t mask;
                 unsigned int now;  // incremented when root changes
                 uint64_t baseHash; // For fast clearing
+                int policy;        // enum ttPolicy
+
+                // Runner-up moves of PV nodes, to try after the hash move
+                struct {
+                        uint64_t key;
+                        int move;
+                } secondMoves[secondMovesLen];
         } tt;
 
         List(killersTuple) killers;
-        short historyCounts[4096];
+        short historyCounts[2*8*64]; // side, piece tag, to-square
 
         // last search result
         struct {
@@ -96,10 +140,14 @@ struct Engine {
                 int ponderMove;
                 intList pv;
                 double seconds;
+                bool aborted; // The last iteration didn't complete
+                double alarmSeconds; // Time taken by setAlarm, for the latency statistics
                 volatile long long nodeCount;
+                List(struct rootMove) rootMoves; // Kept over iterations for move ordering
+                struct searchStats stats;
         };
 
-        struct {
+        struct searchTarget {
                 double time;
                 double maxTime;
                 int depth;
@@ -107,12 +155,22 @@ struct Engine {
                 intPair scores;
         } target;
 
+        const int *searchParams; // searchVector, unless set otherwise for self-play
+
         searchInfo_fn *infoFunction;
         void *infoData;
 
+        charList infoLine; // For uciSearchInfo
+
+        // Memory for the lists. The search doesn't allocate from the heap
+        struct arena gameArena;   // Board histories, reset by newGame
+        struct arena searchArena; // Search lists, reset by newSearch
+
         volatile bool pondering;
+        bool interrupted; // Search aborted by SIGINT (Python module only)
         xAlarm_t alarmHandle;
         void *abortTarget;
+        void *sampleFile; // FILE pointer for writing search samples, or null
 };
 
 /*
@@ -130,7 +188,10 @@ struct Engine {
 extern int globalVector[];
 extern const int vectorLen;
 extern const char * const vectorLabels[];
-extern bool globalVectorChanged;
+
+extern int searchVector[];
+extern const int searchVectorLen;
+extern const char * const searchLabels[];
 
 /*----------------------------------------------------------------------+
  |      Functions                                                       |
@@ -146,9 +207,18 @@ void abortSearch(void *engine);
 /*
  *  Evaluate
  */
-void resetEvaluate(void);
 int evaluate(Board_t self);
 
+/*
+ *  Evaluation vectors. A null vector means the default vector
+ */
+Vector_t newVector(void);
+void freeVector(Vector_t vector);
+int *vectorCoefficients(Vector_t vector);
+void resetEvaluate(Vector_t vector);
+void syncVector(Vector_t vector);
+int setCoefficient(Vector_t vector, int coef, int newValue);
+
 /*
  *  Transposition table
  */
@@ -156,17 +226,28 @@ int evaluate(Board_t self);
 void ttSetSize(Engine_t self, size_t size);
 int ttWrite(Engine_t self, struct ttSlot slot, int depth, int score, int alpha, int beta);
 struct ttSlot ttRead(Engine_t self);
+struct ttSlot ttReadHash(Engine_t self, uint64_t boardHash, int plyNumber);
+void ttPrefetch(Engine_t self, uint64_t boardHash);
+int ttReadSecondMove(Engine_t self);
+void ttWriteSecondMove(Engine_t self, int move);
 void ttClearFast(Engine_t self);
 double ttCalcLoad(Engine_t self);
 
 /*
  *  Time control
  */
-void setTimeTargets(Engine_t self, double time, double inc, int movestogo, double movetime);
+void setTimeTargets(Engine_t self, double time, double inc, int movestogo, double movetime, double overhead);
 
 // Init and cleanup
 void initEngine(Engine_t self);
 void cleanupEngine(Engine_t self);
+void newGame(Engine_t self);
+void newSearch(Engine_t self);
+
+/*
+ *  Self-play
+ */
+int playGame(Engine_t engines[2], const char *fen, int maxPlies, intList *moves);
 
 /*----------------------------------------------------------------------+
  |                                                                      |
@@ -23,6 +23,7 @@
 #include <math.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -30,6 +31,7 @@
 #include <time.h>
 
 #if defined(_WIN32)
+ #define _WIN32_WINNT 0x0600 // For condition variables
  #include <windows.h>
  #include <process.h>
  #include <sys/timeb.h>
@@ -56,6 +58,104 @@ err_t freeErr(err_t err)
         return OK;
 }
 
+/*----------------------------------------------------------------------+
+ |      Arenas                                                          |
+ +----------------------------------------------------------------------*/
+
+long long xAllocCount; // Updated by all threads, atomically
+
+// Header of a heap block for a request that didn't fit in the arena
+union spillBlock {
+        union spillBlock *next;
+        max_align_t align;
+};
+
+static size_t alignSize(size_t size)
+{
+        size_t align = _Alignof(max_align_t);
+        return (size + align - 1) & ~(align - 1);
+}
+
+static void *xMalloc(size_t size)
+{
+        void *p = malloc(size);
+        if (p == null) xAbort(errno, "malloc");
+        __sync_fetch_and_add(&xAllocCount, 1);
+        return p;
+}
+
+void initArena(struct arena *arena, size_t size)
+{
+        *arena = (struct arena) emptyArena;
+        arena->size = alignSize(size);
+        arena->block = xMalloc(arena->size);
+}
+
+void *arenaAlloc(struct arena *arena, size_t size)
+{
+        size = alignSize(size);
+        if (size <= arena->size - arena->used) {
+                arena->last = arena->block + arena->used;
+                arena->used += size;
+                return arena->last;
+        }
+
+        union spillBlock *spill = xMalloc(sizeof(*spill) + size);
+        spill->next = arena->spillChain;
+        arena->spillChain = spill;
+        arena->spilled += size;
+        return spill + 1;
+}
+
+/*
+ *  Like realloc. The latest allocation from the block grows in place if
+ *  there is room. Otherwise the contents move and the old space is lost
+ *  until the next reset.
+ */
+void *arenaResize(struct arena *arena, void *p, size_t oldSize, size_t newSize)
+{
+        if (p != null && p == arena->last) {
+                size_t offset = (char*) p - arena->block;
+                if (alignSize(newSize) <= arena->size - offset) {
+                        arena->used = offset + alignSize(newSize);
+                        return p;
+                }
+        }
+
+        void *q = arenaAlloc(arena, newSize);
+        if (p != null)
+                memcpy(q, p, min(oldSize, newSize));
+        return q;
+}
+
+static void freeSpillChain(struct arena *arena)
+{
+        while (arena->spillChain != null) {
+                union spillBlock *spill = arena->spillChain;
+                arena->spillChain = spill->next;
+                free(spill);
+        }
+}
+
+void resetArena(struct arena *arena)
+{
+        if (arena->spilled > 0) { // Grow the block, so next time it fits
+                freeSpillChain(arena);
+                size_t size = max(2 * arena->size, arena->size + arena->spilled);
+                free(arena->block);
+                initArena(arena, size);
+        }
+        arena->used = 0;
+        arena->last = null;
+}
+
+void freeArena(struct arena *arena)
+{
+        freeSpillChain(arena);
+        free(arena->block);
+        *arena = (struct arena) emptyArena;
+}
+
 /*----------------------------------------------------------------------+
  |      Lists                                                           |
  +----------------------------------------------------------------------*/
@@ -83,8 +183,15 @@ err_t listEnsureMaxLen(voidList *list, int itemSize, int minLen, int minSize)
                 newMax *= 2; // TODO: make this robust for huge lists (overflows etc)
 
         if (newMax != list->maxLen) {
-                void *v = realloc(list->v, newMax * itemSize);
-                if (v == null) xRaise("Out of memory");
+                void *v;
+                if (list->arena != null)
+                        v = arenaResize(list->arena, list->v,
+                                (size_t) list->maxLen * itemSize, (size_t) newMax * itemSize);
+                else {
+                        v = realloc(list->v, newMax * itemSize);
+                        if (v == null) xRaise("Out of memory");
+                        __sync_fetch_and_add(&xAllocCount, 1);
+                }
                 list->v = v;
                 list->maxLen = newMax;
         }
@@ -456,6 +563,378 @@ void clearAlarm(xAlarm_t alarm)
 }
 #endif
 
+/*----------------------------------------------------------------------+
+ |      Processors                                                      |
+ +----------------------------------------------------------------------*/
+
+int xNumberOfCores(void)
+{
+#if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return max(1, (int) info.dwNumberOfProcessors);
+#else
+        return max(1, (int) sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+}
+
+/*----------------------------------------------------------------------+
+ |      Locks (Windows)                                                 |
+ +----------------------------------------------------------------------*/
+#if defined(_WIN32)
+
+typedef CRITICAL_SECTION xMutex_t;
+typedef CONDITION_VARIABLE xCond_t;
+
+static void initMutex(xMutex_t *mutex)      { InitializeCriticalSection(mutex); }
+static void destroyMutex(xMutex_t *mutex)   { DeleteCriticalSection(mutex); }
+static void lockMutex(xMutex_t *mutex)      { EnterCriticalSection(mutex); }
+static void unlockMutex(xMutex_t *mutex)    { LeaveCriticalSection(mutex); }
+
+static void initCond(xCond_t *cond)         { InitializeConditionVariable(cond); }
+static void destroyCond(xCond_t *cond)      { unused(cond); }
+static void broadcastCond(xCond_t *cond)    { WakeAllConditionVariable(cond); }
+
+static void waitCond(xCond_t *cond, xMutex_t *mutex)
+{
+        if (!SleepConditionVariableCS(cond, mutex, INFINITE))
+                xAbort(GetLastError(), "SleepConditionVariableCS");
+}
+#endif
+
+/*----------------------------------------------------------------------+
+ |      Locks (POSIX)                                                   |
+ +----------------------------------------------------------------------*/
+#if defined(POSIX)
+
+typedef pthread_mutex_t xMutex_t;
+typedef pthread_cond_t xCond_t;
+
+static void initMutex(xMutex_t *mutex)      { cAbort(pthread_mutex_init(mutex, null), "pthread_mutex_init"); }
+static void destroyMutex(xMutex_t *mutex)   { cAbort(pthread_mutex_destroy(mutex), "pthread_mutex_destroy"); }
+static void lockMutex(xMutex_t *mutex)      { cAbort(pthread_mutex_lock(mutex), "pthread_mutex_lock"); }
+static void unlockMutex(xMutex_t *mutex)    { cAbort(pthread_mutex_unlock(mutex), "pthread_mutex_unlock"); }
+
+static void initCond(xCond_t *cond)         { cAbort(pthread_cond_init(cond, null), "pthread_cond_init"); }
+static void destroyCond(xCond_t *cond)      { cAbort(pthread_cond_destroy(cond), "pthread_cond_destroy"); }
+static void broadcastCond(xCond_t *cond)    { cAbort(pthread_cond_broadcast(cond), "pthread_cond_broadcast"); }
+
+static void waitCond(xCond_t *cond, xMutex_t *mutex)
+{
+        cAbort(pthread_cond_wait(cond, mutex), "pthread_cond_wait");
+}
+#endif
+
+/*----------------------------------------------------------------------+
+ |      Locks                                                           |
+ +----------------------------------------------------------------------*/
+
+struct lockHandle {
+        xMutex_t mutex;
+};
+
+xLock_t createLock(void)
+{
+        xLock_t lock = malloc(sizeof(*lock));
+        if (!lock) xAbort(errno, "malloc");
+        initMutex(&lock->mutex);
+        return lock;
+}
+
+void destroyLock(xLock_t lock)
+{
+        destroyMutex(&lock->mutex);
+        free(lock);
+}
+
+void acquireLock(xLock_t lock) { lockMutex(&lock->mutex); }
+void releaseLock(xLock_t lock) { unlockMutex(&lock->mutex); }
+
+/*----------------------------------------------------------------------+
+ |      Thread pool                                                     |
+ +----------------------------------------------------------------------*/
+
+// Tasks waited for together, such as the chunks of a parallelFor
+struct taskGroup {
+        long pending; // Under the pool mutex
+};
+
+struct poolTask {
+        thread_fn *function;
+        void *data;
+        struct taskGroup *group; // Or null
+};
+
+/*
+ *  Ring buffer with the oldest task at `top' and the newest at `bottom-1'.
+ *  The owner pushes and pops at the bottom, others steal from the top.
+ *  Each deque has its own mutex, so workers only contend when stealing.
+ */
+struct taskDeque {
+        xMutex_t mutex;
+        struct poolTask *v;
+        long top, bottom;
+        long maxLen; // 0 or a power of 2
+};
+
+struct workerThread {
+        xPool_t pool;
+        int index;
+        xThread_t thread;
+};
+
+struct threadPool {
+        int nrWorkers;
+        struct workerThread *workers;
+        struct taskDeque *deques; // One per worker, and a shared one for outside submissions
+
+        xMutex_t mutex;           // For the fields below
+        xCond_t workAvailable;    // Tasks queued, or stopping
+        xCond_t workDone;         // A group or all tasks finished
+        long nrQueued;            // Tasks in the deques
+        long nrPending;           // Tasks queued or running
+        bool stopping;
+};
+
+static _Thread_local struct workerThread *currentWorker;
+
+static void pushBottom(struct taskDeque *deque, struct poolTask task)
+{
+        if (deque->bottom - deque->top == deque->maxLen) { // Full: grow
+                long newLen = max(64, 2 * deque->maxLen);
+                struct poolTask *v = malloc(newLen * sizeof(v[0]));
+                if (!v) xAbort(errno, "malloc");
+                for (long i=deque->top; i<deque->bottom; i++)
+                        v[i & (newLen - 1)] = deque->v[i & (deque->maxLen - 1)];
+                free(deque->v);
+                deque->v = v;
+                deque->maxLen = newLen;
+        }
+        deque->v[deque->bottom++ & (deque->maxLen - 1)] = task;
+}
+
+static bool popTask(struct taskDeque *deque, bool newest, struct poolTask *task)
+{
+        lockMutex(&deque->mutex);
+        bool found = deque->bottom > deque->top;
+        if (found)
+                *task = newest ? deque->v[--deque->bottom & (deque->maxLen - 1)]
+                               : deque->v[deque->top++ & (deque->maxLen - 1)];
+        unlockMutex(&deque->mutex);
+        return found;
+}
+
+// Own newest task first, else steal the oldest from the others in turn
+static bool findTask(xPool_t pool, int index, struct poolTask *task)
+{
+        int nrDeques = pool->nrWorkers + 1;
+        bool found = popTask(&pool->deques[index], true, task);
+        for (int i=1; i<nrDeques && !found; i++)
+                found = popTask(&pool->deques[(index + i) % nrDeques], false, task);
+        if (found) {
+                lockMutex(&pool->mutex);
+                pool->nrQueued--;
+                unlockMutex(&pool->mutex);
+        }
+        return found;
+}
+
+static void runTask(xPool_t pool, struct poolTask task)
+{
+        task.function(task.data);
+
+        lockMutex(&pool->mutex);
+        pool->nrPending--;
+        bool groupDone = task.group && --task.group->pending == 0;
+        if (groupDone || pool->nrPending == 0)
+                broadcastCond(&pool->workDone);
+        unlockMutex(&pool->mutex);
+}
+
+static void pushTasks(xPool_t pool, int n, const struct poolTask tasks[])
+{
+        // Count first, so that the tasks are never done before they're counted
+        lockMutex(&pool->mutex);
+        pool->nrQueued += n;
+        pool->nrPending += n;
+        unlockMutex(&pool->mutex);
+
+        int index = poolWorker(pool);
+        struct taskDeque *deque = &pool->deques[(index >= 0) ? index : pool->nrWorkers];
+        lockMutex(&deque->mutex);
+        for (int i=0; i<n; i++)
+                pushBottom(deque, tasks[i]);
+        unlockMutex(&deque->mutex);
+
+        lockMutex(&pool->mutex);
+        broadcastCond(&pool->workAvailable);
+        unlockMutex(&pool->mutex);
+}
+
+static void workerStart(void *data)
+{
+        struct workerThread *worker = data;
+        xPool_t pool = worker->pool;
+        currentWorker = worker;
+
+        for (;;) {
+                struct poolTask task;
+                if (findTask(pool, worker->index, &task)) {
+                        runTask(pool, task);
+                        continue;
+                }
+                lockMutex(&pool->mutex);
+                while (pool->nrQueued == 0 && !pool->stopping)
+                        waitCond(&pool->workAvailable, &pool->mutex);
+                bool stop = pool->nrQueued == 0 && pool->stopping;
+                unlockMutex(&pool->mutex);
+                if (stop)
+                        break;
+        }
+}
+
+// Wait for a group of tasks. Workers run other tasks in the meantime
+static void waitGroup(xPool_t pool, struct taskGroup *group)
+{
+        int index = poolWorker(pool);
+        for (;;) {
+                struct poolTask task;
+                if (index >= 0 && findTask(pool, index, &task)) {
+                        runTask(pool, task);
+                        continue;
+                }
+                lockMutex(&pool->mutex);
+                bool done = group->pending == 0;
+                if (!done)
+                        waitCond(&pool->workDone, &pool->mutex);
+                unlockMutex(&pool->mutex);
+                if (done)
+                        break;
+        }
+}
+
+xPool_t createPool(int nrThreads)
+{
+        xPool_t pool = calloc(1, sizeof(*pool));
+        if (!pool) xAbort(errno, "calloc");
+
+        pool->nrWorkers = (nrThreads > 0) ? nrThreads : xNumberOfCores();
+        pool->workers = calloc(pool->nrWorkers, sizeof(pool->workers[0]));
+        pool->deques = calloc(pool->nrWorkers + 1, sizeof(pool->deques[0]));
+        if (!pool->workers || !pool->deques) xAbort(errno, "calloc");
+
+        initMutex(&pool->mutex);
+        initCond(&pool->workAvailable);
+        initCond(&pool->workDone);
+        for (int i=0; i<=pool->nrWorkers; i++)
+                initMutex(&pool->deques[i].mutex);
+
+        for (int i=0; i<pool->nrWorkers; i++) {
+                pool->workers[i].pool = pool;
+                pool->workers[i].index = i;
+                pool->workers[i].thread = createThread(workerStart, &pool->workers[i]);
+        }
+        return pool;
+}
+
+void destroyPool(xPool_t pool)
+{
+        lockMutex(&pool->mutex);
+        pool->stopping = true;
+        broadcastCond(&pool->workAvailable);
+        unlockMutex(&pool->mutex);
+
+        for (int i=0; i<pool->nrWorkers; i++)
+                joinThread(pool->workers[i].thread);
+
+        for (int i=0; i<=pool->nrWorkers; i++) {
+                destroyMutex(&pool->deques[i].mutex);
+                free(pool->deques[i].v);
+        }
+        destroyCond(&pool->workDone);
+        destroyCond(&pool->workAvailable);
+        destroyMutex(&pool->mutex);
+        free(pool->deques);
+        free(pool->workers);
+        free(pool);
+}
+
+int poolSize(xPool_t pool)
+{
+        return pool->nrWorkers;
+}
+
+int poolWorker(xPool_t pool)
+{
+        return (currentWorker && currentWorker->pool == pool) ? currentWorker->index : -1;
+}
+
+void poolSubmit(xPool_t pool, thread_fn *function, void *data)
+{
+        poolSubmitBatch(pool, 1, function, &data);
+}
+
+void poolSubmitBatch(xPool_t pool, int n, thread_fn *function, void *data[])
+{
+        if (n <= 0)
+                return;
+        struct poolTask *tasks = malloc(n * sizeof(tasks[0]));
+        if (!tasks) xAbort(errno, "malloc");
+        for (int i=0; i<n; i++)
+                tasks[i] = (struct poolTask) { .function = function, .data = data[i], .group = null };
+        pushTasks(pool, n, tasks);
+        free(tasks);
+}
+
+void poolWait(xPool_t pool)
+{
+        lockMutex(&pool->mutex);
+        while (pool->nrPending > 0)
+                waitCond(&pool->workDone, &pool->mutex);
+        unlockMutex(&pool->mutex);
+}
+
+struct rangeChunk {
+        xPool_t pool;
+        range_fn *function;
+        void *data;
+        long begin, end;
+};
+
+static void runChunk(void *data)
+{
+        struct rangeChunk *chunk = data;
+        chunk->function(chunk->data, poolWorker(chunk->pool), chunk->begin, chunk->end);
+}
+
+void parallelFor(xPool_t pool, long begin, long end, long grain, range_fn *function, void *data)
+{
+        if (end <= begin)
+                return;
+        if (grain <= 0) // About 8 chunks per worker, for balance
+                grain = max(1, (end - begin) / (8 * pool->nrWorkers));
+        int n = (end - begin + grain - 1) / grain;
+
+        struct rangeChunk *chunks = malloc(n * sizeof(chunks[0]));
+        struct poolTask *tasks = malloc(n * sizeof(tasks[0]));
+        if (!chunks || !tasks) xAbort(errno, "malloc");
+
+        struct taskGroup group = { .pending = n };
+        for (int i=0; i<n; i++) {
+                long chunkBegin = begin + i * grain;
+                chunks[i] = (struct rangeChunk) {
+                        .pool = pool, .function = function, .data = data,
+                        .begin = chunkBegin, .end = min(end, chunkBegin + grain)
+                };
+                tasks[i] = (struct poolTask) { .function = runChunk, .data = &chunks[i], .group = &group };
+        }
+        pushTasks(pool, n, tasks);
+        waitGroup(pool, &group);
+
+        free(tasks);
+        free(chunks);
+}
+
 /*----------------------------------------------------------------------+
  |                                                                      |
  +----------------------------------------------------------------------*/
@@ -96,18 +96,55 @@ err_t freeErr(err_t err);
 #define Pair(type)              Tuple(type, 2)
 typedef Pair(int)               intPair;
 
+/*----------------------------------------------------------------------+
+ |      Arenas                                                          |
+ +----------------------------------------------------------------------*/
+
+/*
+ *  An arena hands out memory from a single block by bumping a pointer.
+ *  All of it is taken back at once by resetArena, in O(1). Requests that
+ *  don't fit come from the heap instead. These are freed at the next reset,
+ *  and then the block grows so that it can hold them the next time around.
+ */
+struct arena {
+        char *block;
+        size_t used;
+        size_t size;
+        size_t spilled;  // Bytes that didn't fit since the last reset
+        void *spillChain; // ... and the heap blocks holding these
+        void *last;       // Latest allocation from the block, can grow in place
+};
+
+#define emptyArena { null, 0, 0, 0, null, null }
+
+void initArena(struct arena *arena, size_t size);
+void *arenaAlloc(struct arena *arena, size_t size);
+void *arenaResize(struct arena *arena, void *p, size_t oldSize, size_t newSize);
+void resetArena(struct arena *arena);
+void freeArena(struct arena *arena);
+
+// Heap allocations by lists and arenas in all threads, for checking that hot
+// paths have none
+extern long long xAllocCount;
+
 /*----------------------------------------------------------------------+
  |      Lists                                                           |
  +----------------------------------------------------------------------*/
 
+/*
+ *  A list takes its memory from the heap, or from an arena after bindList.
+ *  Before resetting that arena all lists bound to it must be freed, which
+ *  doesn't return anything to the arena and keeps them bound.
+ */
 #define List(type)\
 struct {\
         type *v;\
         int len;\
         int maxLen;\
+        struct arena *arena;\
 }
 
-#define emptyList { null, 0, 0 }
+#define emptyList { null, 0, 0, null }
 
 typedef List(uint8_t)   uByteList;
 typedef List(int8_t)    sByteList;
@@ -140,12 +177,18 @@ typedef List(void)      voidList;
 
 #define freeList(list) Statement(\
         if ((list).v) {                                         \
-                free((list).v);                                 \
+                if (!(list).arena)                              \
+                        free((list).v);                         \
                 (list).v = null;                                \
                 (list).len = 0;                                 \
                 (list).maxLen = 0;                              \
         })
 
+#define bindList(list, arenaPointer) Statement(\
+        freeList(list);                                         \
+        (list).arena = (arenaPointer);                          \
+)
+
 err_t listEnsureMaxLen(voidList *list, int itemSize, int minLen, int minSize);
 void listPrintf(charList *list, const char *format, ...);
 
@@ -198,6 +241,48 @@ typedef struct alarmHandle *xAlarm_t;
 xAlarm_t setAlarm(double delay, thread_fn *function, void *data);
 void clearAlarm(xAlarm_t alarm);
 
+// Number of processors available, at least 1
+int xNumberOfCores(void);
+
+// Mutual exclusion between threads
+typedef struct lockHandle *xLock_t;
+xLock_t createLock(void);
+void destroyLock(xLock_t lock);
+void acquireLock(xLock_t lock);
+void releaseLock(xLock_t lock);
+
+/*----------------------------------------------------------------------+
+ |      Thread pool                                                     |
+ +----------------------------------------------------------------------*/
+
+/*
+ *  A pool of worker threads with work stealing. Each worker has its own
+ *  deque of tasks. It runs the newest task from its own deque first and,
+ *  when that is empty, steals the oldest task from another worker. Tasks
+ *  submitted from outside the pool go to a shared deque. Tasks can submit
+ *  more tasks, and wait for them while helping to run the others.
+ */
+typedef struct threadPool *xPool_t;
+
+xPool_t createPool(int nrThreads); // 0 means one per core
+void destroyPool(xPool_t pool);    // Finishes all tasks first
+int poolSize(xPool_t pool);
+
+// Index of the calling worker in the pool (0..poolSize-1), or -1 outside the pool
+int poolWorker(xPool_t pool);
+
+void poolSubmit(xPool_t pool, thread_fn *function, void *data);
+void poolSubmitBatch(xPool_t pool, int n, thread_fn *function, void *data[]);
+void poolWait(xPool_t pool); // Until all submitted tasks are done
+
+/*
+ *  Run function over [begin, end) in chunks of `grain' indices (0 for a
+ *  default), as a batch of tasks. Returns when all chunks are done.
+ *  `worker' is the index of the worker running the chunk.
+ */
+typedef void range_fn(void *data, int worker, long begin, long end);
+void parallelFor(xPool_t pool, long begin, long end, long grain, range_fn *function, void *data);
+
 /*----------------------------------------------------------------------+
  |                                                                      |
  +----------------------------------------------------------------------*/
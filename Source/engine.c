@@ -30,6 +30,18 @@
 #include "Board.h"
 #include "Engine.h"
 
+/*----------------------------------------------------------------------+
+ |      Definitions                                                     |
+ +----------------------------------------------------------------------*/
+
+#define KiB (1 << 10)
+
+// Reserved list lengths. Beyond these the lists still grow inside their arena
+#define reservedPlies 1024
+#define reservedUndoBytes 16 // Per ply, enough for any move
+#define reservedPvLen (8 * maxDepth)
+#define reservedInfoLen (4 * KiB)
+
 /*----------------------------------------------------------------------+
  |      Functions                                                       |
  +----------------------------------------------------------------------*/
@@ -37,6 +49,21 @@
 void initEngine(Engine_t self)
 {
         memset(self, 0, sizeof(struct Engine));
+        self->searchParams = searchVector;
+
+        initArena(&self->gameArena, 64 * KiB);
+        bindList(self->board.hashHistory, &self->gameArena);
+        bindList(self->board.pkHashHistory, &self->gameArena);
+        bindList(self->board.materialHistory, &self->gameArena);
+        bindList(self->board.undoStack, &self->gameArena);
+        newGame(self);
+
+        initArena(&self->searchArena, 64 * KiB);
+        bindList(self->pv, &self->searchArena);
+        bindList(self->killers, &self->searchArena);
+        bindList(self->rootMoves, &self->searchArena);
+        bindList(self->infoLine, &self->searchArena);
+        newSearch(self);
 }
 
 void cleanupEngine(Engine_t self)
@@ -47,10 +74,120 @@ void cleanupEngine(Engine_t self)
         freeList(self->board.undoStack);
         freeList(self->searchMoves);
         freeList(self->pv);
+        freeList(self->rootMoves);
         freeList(self->killers);
+        freeList(self->infoLine);
+        freeArena(&self->gameArena);
+        freeArena(&self->searchArena);
         free(self->tt.slots);
 }
 
+/*
+ *  Drop the board histories in O(1). The board must be setup again after this.
+ */
+void newGame(Engine_t self)
+{
+        freeList(self->board.hashHistory);
+        freeList(self->board.pkHashHistory);
+        freeList(self->board.materialHistory);
+        freeList(self->board.undoStack);
+        resetArena(&self->gameArena);
+
+        preparePushList(self->board.hashHistory, reservedPlies);
+        preparePushList(self->board.pkHashHistory, reservedPlies);
+        preparePushList(self->board.materialHistory, reservedPlies);
+        preparePushList(self->board.undoStack, reservedPlies * reservedUndoBytes);
+}
+
+/*
+ *  Drop the search lists in O(1) when the root position changes
+ */
+void newSearch(Engine_t self)
+{
+        freeList(self->pv);
+        freeList(self->killers);
+        freeList(self->rootMoves);
+        freeList(self->infoLine);
+        resetArena(&self->searchArena);
+
+        preparePushList(self->pv, reservedPvLen);
+        preparePushList(self->killers, 2 * maxDepth);
+        preparePushList(self->rootMoves, maxMoves);
+        preparePushList(self->infoLine, reservedInfoLen);
+}
+
+/*----------------------------------------------------------------------+
+ |      playGame                                                        |
+ +----------------------------------------------------------------------*/
+
+static bool hasLegalMove(Board_t self)
+{
+        updateSideInfo(self);
+        int moveList[maxMoves];
+        int nrMoves = generateMoves(self, moveList, generateAll);
+        for (int i=0; i<nrMoves; i++)
+                if (isLegalMove(self, moveList[i]))
+                        return true;
+        return false;
+}
+
+// Threefold repetition, counting the current position
+static bool isThreefold(Board_t self)
+{
+        int count = 1;
+        int lastZeroing = max(0, self->hashHistory.len - self->halfmoveClock);
+        for (int ix=self->hashHistory.len-4; ix>=lastZeroing; ix-=2)
+                if (self->hashHistory.v[ix] == self->hash)
+                        count++;
+        return count >= 3;
+}
+
+/*
+ *  Play a game between two engines (white first) from the given position.
+ *  Each engine searches with its own target, parameters and transposition
+ *  table, and both boards follow the game. Games without a result after
+ *  maxPlies are drawn. Returns the result for white (1, 0 or -1), or 0
+ *  when a search was interrupted. The moves are pushed onto `moves'.
+ */
+int playGame(Engine_t engines[2], const char *fen, int maxPlies, intList *moves)
+{
+        for (int i=0; i<2; i++) {
+                newGame(engines[i]);
+                if (setupBoard(board(engines[i]), fen) <= 0)
+                        return 0;
+        }
+        Board_t board = board(engines[0]);
+        int result = 0;
+        struct searchTarget targets[2] = { engines[0]->target, engines[1]->target };
+
+        for (int ply=0; ply<maxPlies; ply++) {
+                if (!hasLegalMove(board)) {
+                        if (isInCheck(board))
+                                result = (sideToMove(board) == white) ? -1 : 1; // Mate
+                        break;
+                }
+                if (board->halfmoveClock >= 100 || isThreefold(board))
+                        break;
+
+                int side = sideToMove(board);
+                Engine_t self = engines[side];
+                self->target = targets[side]; // An alarm clears the node target
+                rootSearch(self);
+                if (self->interrupted || !self->bestMove)
+                        break;
+
+                int move = self->bestMove;
+                if (moves)
+                        pushList(*moves, move);
+                for (int i=0; i<2; i++)
+                        makeMove(board(engines[i]), move);
+        }
+
+        engines[0]->target = targets[0];
+        engines[1]->target = targets[1];
+        return result;
+}
+
 /*----------------------------------------------------------------------+
  |                                                                      |
  +----------------------------------------------------------------------*/
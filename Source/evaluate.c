@@ -55,8 +55,13 @@ enum vector {
         #undef P
 };
 
+/*
+ *  Slots of the evaluation caches are only valid in the current generation
+ *  of their table. A new generation invalidates the whole table in O(1).
+ */
 struct mSlot {
         uint64_t materialKey;
+        unsigned short generation;
         int wiloScore[2];
         int drawScore;
         double passerScaling[2];
@@ -65,6 +70,7 @@ struct mSlot {
 
 struct pkSlot {
         uint64_t pawnKingHash;
+        unsigned short generation;
         short wiloScore[2];
         short drawScore;
         short passerScore[2];
@@ -102,6 +108,18 @@ struct pkSlot {
 #define nrMajors(side)     (nrRooks(side)   + nrQueens(side))
 #define nrSliders(side)    (nrBishops(side) + nrRooks(side) + nrQueens(side))
 
+/*
+ *  Pawn sets follow the square numbering: each byte is a file and
+ *  the bits within it are the ranks. So shifting by 1 steps along the
+ *  file and shifting by 8 steps to the neighbouring file.
+ */
+#define fileBits(set, file) (int) (inRange(file, fileA, fileH) ? ((set) >> (8 * (file))) & 0xff : 0)
+#define north(set)          (((set) << 1) & 0xfefefefefefefefeULL)
+#define south(set)          (((set) >> 1) & 0x7f7f7f7f7f7f7f7fULL)
+#define pawnZone            0x7e7e7e7e7e7e7e7eULL
+#define firstPawns(set)     ((set) & ~fillNorth(north(set)))
+#define lastPawns(set)      ((set) & ~fillSouth(south(set)))
+
 /*----------------------------------------------------------------------+
  |      Data                                                            |
  +----------------------------------------------------------------------*/
@@ -119,7 +137,6 @@ int globalVector[] = {
         #include "vector.h"
         #undef P
 };
-bool globalVectorChanged = false; // TODO: move to Python engine object
 
 static const int firstRank[] = { rank1, rank8 }; // white, black
 static const int pawnStep[] = { a3 - a2, a6 - a7 };
@@ -145,16 +162,75 @@ static const int kingZoneCenter[] = {
 #define pawnKingLen (1L << 17) // must be power of 2
 static struct pkSlot pawnKingTable[pawnKingLen];
 
-static struct mSlot materialTable[1L<<16]; // size is really fixed
+#define materialLen (1L << 16) // size is really fixed
+static struct mSlot materialTable[materialLen];
+
+/*
+ *  An evaluation vector with its own caches. The default vector is
+ *  globalVector, which is used when the board has no vector attached.
+ *  Different vectors can evaluate in different threads at the same time.
+ */
+struct Vector {
+        int *v;      // Coefficients, may also be changed directly (see syncVector)
+        int *cached; // The coefficients that the caches are valid for
+        struct mSlot *materialTable;
+        struct pkSlot *pawnKingTable;
+        unsigned short materialGeneration;
+        unsigned short pawnKingGeneration;
+};
+
+static int cachedGlobalVector[] = {
+        #define P(id, value) [id] = (value)
+        #include "vector.h"
+        #undef P
+};
+
+static struct Vector defaultVector = {
+        .v = globalVector,
+        .cached = cachedGlobalVector,
+        .materialTable = materialTable,
+        .pawnKingTable = pawnKingTable,
+        .materialGeneration = 1,
+        .pawnKingGeneration = 1,
+};
+
+#define orDefault(vector) ((vector) ? (vector) : &defaultVector)
+
+enum { materialCache = 1, pawnKingCache = 2 };
+
+/*
+ *  Coefficients that the cached evaluations depend on, as ranges in
+ *  vector order. These must cover every coefficient that is read by
+ *  evaluateMaterial and extractPawnStructure respectively.
+ */
+static const intPair materialCoefficients[] = {
+        {{ winBonus, winBonus }},
+        {{ queenValue, knightVsPawn_2 }},
+        {{ safetyScalingOffset, safetyVsPawn }},
+        {{ passerScalingOffset, passerVsPawn }},
+        {{ drawOffset, drawUnlikeBishopsAndKnights }},
+};
+
+static const intPair pawnKingCoefficients[] = {
+        {{ castleK, castleKQ }},
+        {{ shelterPawn_0, shelterKing_2 }},
+        {{ shelterCastled, shelterCastled }},
+        {{ pawnByFile_0, mobilePawn_5 }},
+        {{ passerA_0, passerH_2 }},
+        {{ protectedPasser, connectedPasser }},
+        {{ candidateByRank_0, candidateH }},
+        {{ bishopAndLikePawn_1, bishopVsLikeRammedPawn }},
+        {{ drawRammed_0, drawRammed_3 }},
+};
 
 /*----------------------------------------------------------------------+
  |      Functions                                                       |
  +----------------------------------------------------------------------*/
 
-static void evaluateMaterial(Board_t self, struct mSlot *mSlot);
+static void evaluateMaterial(Board_t self, const int v[vectorLen], struct mSlot *mSlot);
 static void extractPawnStructure(Board_t self, const int v[vectorLen], struct pkSlot *pawns);
 // TODO: cleanup these function prototypes
-static void evaluatePawnFile(Board_t self, const int v[vectorLen], struct pkSlot *pawns, int file, int side, int maxPawnFromFirst[2][10][2]);
+static void evaluatePawns(Board_t self, const int v[vectorLen], struct pkSlot *pawns, int side, uint64_t own, uint64_t opp);
 static int evaluatePasser(Board_t self, const int v[vectorLen], int fileFlag, int side, int passerSquare[2][8]);
 static int evaluateKnight(Board_t self, const int v[vectorLen], const struct pkSlot *pawns, int square, int side);
 static int evaluateBishop(Board_t self, const int v[vectorLen], const struct pkSlot *pawns, int square, int side);
@@ -162,22 +238,136 @@ static int evaluateRook  (Board_t self, const int v[vectorLen], const struct pkS
 static int evaluateQueen (Board_t self, const int v[vectorLen], const struct pkSlot *pawns, int square, int side, int passerSquare[2][8]);
 static int evaluateKing  (              const int v[vectorLen],                             int square, int side);
 
-static int shelterPenalty(const int v[vectorLen], int side, int file, int maxPawnFromFirst[2][10][2]);
+static int shelterPenalty(const int v[vectorLen], int file, uint64_t own);
+
+static uint64_t fillNorth(uint64_t set);
+static uint64_t fillSouth(uint64_t set);
+static uint64_t flipRanks(uint64_t set);
+static int popCount(uint64_t set);
+
+static int coefficientCaches(int coef);
+static bool inRanges(int coef, const intPair ranges[], int nrRanges);
+static void invalidateCaches(Vector_t vector, int caches);
+static void newGeneration(unsigned short *generation, void *table, size_t size);
 
 static double sigmoid(double x);
 static double logit(double p);
 static int squareOf(Board_t self, int piece);
 
 /*----------------------------------------------------------------------+
- |      resetEvaluate                                                   |
+ |      Vectors                                                         |
  +----------------------------------------------------------------------*/
 
-// Reset evaluation caches (only needed after setCoefficient)
-void resetEvaluate(void)
+/*
+ *  New vector with the coefficients of the default vector, and empty caches.
+ *  Only reads the default vector, so no other thread may change it meanwhile.
+ */
+Vector_t newVector(void)
+{
+        Vector_t vector = calloc(1, sizeof(*vector));
+        if (vector) {
+                vector->v = malloc(vectorLen * sizeof(vector->v[0]));
+                vector->cached = malloc(vectorLen * sizeof(vector->cached[0]));
+                vector->materialTable = calloc(materialLen, sizeof(struct mSlot));
+                vector->pawnKingTable = calloc(pawnKingLen, sizeof(struct pkSlot));
+                vector->materialGeneration = 1;
+                vector->pawnKingGeneration = 1;
+        }
+        if (!vector || !vector->v || !vector->cached
+         || !vector->materialTable || !vector->pawnKingTable) {
+                freeVector(vector);
+                return null;
+        }
+        memcpy(vector->v, globalVector, vectorLen * sizeof(vector->v[0]));
+        memcpy(vector->cached, globalVector, vectorLen * sizeof(vector->cached[0]));
+        return vector;
+}
+
+void freeVector(Vector_t vector)
+{
+        if (vector) {
+                free(vector->v);
+                free(vector->cached);
+                free(vector->materialTable);
+                free(vector->pawnKingTable);
+                free(vector);
+        }
+}
+
+int *vectorCoefficients(Vector_t vector)
+{
+        return orDefault(vector)->v;
+}
+
+// Invalidate all evaluation caches
+void resetEvaluate(Vector_t vector)
+{
+        invalidateCaches(orDefault(vector), materialCache | pawnKingCache);
+}
+
+/*
+ *  Invalidate the caches that depend on coefficients changed since the
+ *  last call. Needed after changing coefficients directly, before evaluate.
+ */
+void syncVector(Vector_t vector)
+{
+        vector = orDefault(vector);
+        int caches = 0;
+        for (int coef=0; coef<vectorLen; coef++)
+                if (vector->v[coef] != vector->cached[coef]) {
+                        caches |= coefficientCaches(coef);
+                        vector->cached[coef] = vector->v[coef];
+                }
+        invalidateCaches(vector, caches);
+}
+
+/*
+ *  Change an evaluation coefficient and return its old value.
+ *  Only the caches that depend on the coefficient are invalidated.
+ */
+int setCoefficient(Vector_t vector, int coef, int newValue)
+{
+        vector = orDefault(vector);
+        int oldValue = vector->v[coef];
+        vector->v[coef] = newValue;
+        syncVector(vector);
+        return oldValue;
+}
+
+static int coefficientCaches(int coef)
+{
+        int caches = 0;
+        if (inRanges(coef, materialCoefficients, arrayLen(materialCoefficients)))
+                caches |= materialCache;
+        if (inRanges(coef, pawnKingCoefficients, arrayLen(pawnKingCoefficients)))
+                caches |= pawnKingCache;
+        return caches;
+}
+
+static bool inRanges(int coef, const intPair ranges[], int nrRanges)
+{
+        for (int i=0; i<nrRanges; i++)
+                if (inRange(coef, ranges[i].v[0], ranges[i].v[1]))
+                        return true;
+        return false;
+}
+
+static void invalidateCaches(Vector_t vector, int caches)
 {
-        memset(materialTable, 0, sizeof materialTable);
-        memset(pawnKingTable, 0, sizeof pawnKingTable);
-        globalVectorChanged = false;
+        if (caches & materialCache)
+                newGeneration(&vector->materialGeneration,
+                        vector->materialTable, materialLen * sizeof(struct mSlot));
+        if (caches & pawnKingCache)
+                newGeneration(&vector->pawnKingGeneration,
+                        vector->pawnKingTable, pawnKingLen * sizeof(struct pkSlot));
+}
+
+static void newGeneration(unsigned short *generation, void *table, size_t size)
+{
+        if (++*generation == 0) { // Wrapped around: clear old slots the hard way
+                memset(table, 0, size);
+                *generation = 1;
+        }
 }
 
 /*----------------------------------------------------------------------+
@@ -186,7 +376,8 @@ void resetEvaluate(void)
 
 int evaluate(Board_t self)
 {
-        const int *v = globalVector;
+        Vector_t vector = orDefault(self->vector);
+        const int *v = vector->v;
 
         /*--------------------------------------------------------------+
          |      Feature extraction                                      |
@@ -199,9 +390,11 @@ int evaluate(Board_t self)
          |      Material balance                                        |
          +--------------------------------------------------------------*/
 
-        struct mSlot *mSlot = &materialTable[materialHash(self->materialKey)];
-        if (mSlot->materialKey != self->materialKey)
-                evaluateMaterial(self, mSlot);
+        struct mSlot *mSlot = &vector->materialTable[materialHash(self->materialKey)];
+        if (mSlot->materialKey != self->materialKey || mSlot->generation != vector->materialGeneration) {
+                evaluateMaterial(self, v, mSlot);
+                mSlot->generation = vector->materialGeneration;
+        }
 
         int wiloScore[2]; // Accumulators
         wiloScore[white] = mSlot->wiloScore[white];
@@ -214,9 +407,11 @@ int evaluate(Board_t self)
         int passerSquare[2][8]; // Mark down passers per file
 
         long pkIndex = self->pawnKingHash & (pawnKingLen - 1);
-        struct pkSlot *pawns = &pawnKingTable[pkIndex];
-        if (pawns->pawnKingHash != self->pawnKingHash)
+        struct pkSlot *pawns = &vector->pawnKingTable[pkIndex];
+        if (pawns->pawnKingHash != self->pawnKingHash || pawns->generation != vector->pawnKingGeneration) {
                 extractPawnStructure(self, v, pawns);
+                pawns->generation = vector->pawnKingGeneration;
+        }
 
         for (int side=white; side<=black; side++) {
                 wiloScore[side] += pawns->wiloScore[side];
@@ -329,6 +524,8 @@ int evaluate(Board_t self)
          |      King safety                                             |
          +--------------------------------------------------------------*/
 
+        int kingZoneAttacks[2];
+
         for (int side=white; side<=black; side++) {
                 int xside = other(side);
                 int king = self->sides[side].king;
@@ -340,6 +537,7 @@ int evaluate(Board_t self)
                                       + (attacks[-1] > 0) + (attacks[ 0] > 0) + (attacks[ 1] > 0)
                                       + (attacks[ 7] > 0) + (attacks[ 8] > 0) + (attacks[ 9] > 0);
                 nrAttackedSquares = min(nrAttackedSquares, 6); // clip at 6
+                kingZoneAttacks[side] = nrAttackedSquares;
 
                 // A measure of distinct pieces attacking the king zone
                 int attackers = attacks[-9] | attacks[-8] | attacks[-7]
@@ -418,6 +616,18 @@ int evaluate(Board_t self)
 
         self->futilityMargin = (nrSliders(side) > 1) ? 122 - 7*hangScore : 5000;
 
+        short *features = self->futilityFeatures;
+        for (int i=0; i<3; i++) {
+                features[featureHanging_0  + i] = hangingPieces[side][i];
+                features[featureHanging_0X + i] = hangingPieces[xside][i];
+        }
+        features[featurePassers]   = popCount(pawns->passerOnFile[side]);
+        features[featurePassersX]  = popCount(pawns->passerOnFile[xside]);
+        features[featureKingZone]  = kingZoneAttacks[side];
+        features[featureKingZoneX] = kingZoneAttacks[xside];
+
+        self->materialPhase = min(3, (allKnights + allBishops + 2 * allRooks + 4 * allQueens) / 6);
+
         /*--------------------------------------------------------------+
          |      Special endgames                                        |
          +--------------------------------------------------------------*/
@@ -509,9 +719,8 @@ int evaluate(Board_t self)
  |      evaluateMaterial                                                |
  +----------------------------------------------------------------------*/
 
-static void evaluateMaterial(Board_t self, struct mSlot *mSlot)
+static void evaluateMaterial(Board_t self, const int v[vectorLen], struct mSlot *mSlot)
 {
-        const int *v = globalVector;
 
         for (int side=white; side<=black; side++) {
                 int xside = other(side);
@@ -667,50 +876,36 @@ static void extractPawnStructure(Board_t self, const int v[vectorLen], struct pk
 {
         *pawns = (struct pkSlot) { .pawnKingHash = self->pawnKingHash };
 
-        /*
-         *  Maximum distance of pawn to first rank, for each file and both sides.
-         *  Used to detect open files, doubled pawns, passers, etc.
-         */
-        int maxPawnFromFirst[2][10][2] = {{{0}}}; // [perspective][1+file][pawnColor]
-
-        /*
-         *  Outmost files with pawns, to extract pawn span and center.
-         *  We don't calculate 'min' directly for easier initialization.
-         */
-        int maxPawnFromFileA[2] = {0};
-        int maxPawnFromFileH[2] = {0};
-
-        int bySquareColor[2][2] = {{0}}; // [pawnColor][squareColor]
-        int rammedBySquareColor[2][2] = {{0}};
-
         // Pawn location scan
+        uint64_t pawnSet[2] = { 0, 0 }; // [pawnColor]
         for (int square=0; square<boardSize; square++) {
                 int piece = self->squares[square];
-                if (isPawn(piece)) {
-                        int file = file(square), rank = rank(square);
-                        int pawnColor = pieceColor(piece);
-                        #define setMax(a, b) if ((a) < (b)) (a) = (b)
-
-                        setMax(maxPawnFromFirst[white][1+file][pawnColor], rank ^ rank1);
-                        setMax(maxPawnFromFirst[black][1+file][pawnColor], rank ^ rank8);
-
-                        setMax(maxPawnFromFileA[pawnColor], file ^ fileA);
-                        setMax(maxPawnFromFileH[pawnColor], file ^ fileH);
+                if (isPawn(piece))
+                        pawnSet[pieceColor(piece)] |= bit(square);
+        }
 
-                        int squareColor = squareColor(square);
-                        bySquareColor[pawnColor][squareColor] += 1;
+        // Pawns that have any pawn directly in front of them
+        uint64_t anyPawn = pawnSet[white] | pawnSet[black];
+        uint64_t rammed[2] = { pawnSet[white] & south(anyPawn),
+                               pawnSet[black] & north(anyPawn) };
 
-                        int inFront = self->squares[square+pawnStep[pawnColor]];
-                        if (isPawn(inFront)) {
-                                rammedBySquareColor[pawnColor][squareColor] += 1;
+        for (int fileType=0; fileType<4; fileType++) {
+                uint64_t files = (0xffULL << (8 * fileType)) | (0xffULL << (8 * flip(fileType)));
+                pawns->drawScore += v[drawRammed_0 + fileType]
+                                  * popCount((rammed[white] | rammed[black]) & files);
+        }
 
-                                int fileType = min(file, flip(file));
-                                pawns->drawScore += v[drawRammed_0 + fileType];
-                        }
+        // Bishop and pawn square color scoring
+        static const uint64_t squareColorMask[] = { ~0xaa55aa55aa55aa55ULL, 0xaa55aa55aa55aa55ULL };
+        int bySquareColor[2][2]; // [pawnColor][squareColor]
+        int rammedBySquareColor[2][2];
+        for (int side=white; side<=black; side++) {
+                for (int squareColor=white; squareColor<=black; squareColor++) {
+                        bySquareColor[side][squareColor] = popCount(pawnSet[side] & squareColorMask[squareColor]);
+                        rammedBySquareColor[side][squareColor] = popCount(rammed[side] & squareColorMask[squareColor]);
                 }
         }
 
-        // Bishop and pawn square color scoring
         for (int side=white; side<=black; side++) {
                 int xside = other(side);
                 for (int squareColor=white; squareColor<=black; squareColor++)
@@ -724,7 +919,16 @@ static void extractPawnStructure(Board_t self, const int v[vectorLen], struct pk
         }
 
         for (int side=white; side<=black; side++) {
-                //pawns->center[side] = (maxPawnFromFileA[side] + (7 - maxPawnFromFileH[side])) / 3;
+                // Outmost files with pawns
+                int maxPawnFromFileA = 0, maxPawnFromFileH = 0;
+                for (int file=fileA; file<=fileH; file++) {
+                        if (fileBits(pawnSet[side], file)) {
+                                maxPawnFromFileA = max(maxPawnFromFileA, file ^ fileA);
+                                maxPawnFromFileH = max(maxPawnFromFileH, file ^ fileH);
+                        }
+                }
+
+                //pawns->center[side] = (maxPawnFromFileA + (7 - maxPawnFromFileH)) / 3;
                 //assert(0 <= pawns->center[side] && pawns->center[side] <= 4);
 
                 // Center [0..14]/3 -> [0..4] and span [0, 2..9]/2 -> [0..4]
@@ -732,14 +936,15 @@ static void extractPawnStructure(Board_t self, const int v[vectorLen], struct pk
                 // | 0 0 0 1 1 1 2 2 2 3 3 3 4 4 4 | = center = (minPawnFile + maxPawnFile) / 3 : [0..4]
                 // +---+---+---+---+---+---+---+---+
                 //   a   b   c   d   e   f   g   h
-                pawns->span[side] = max(0, maxPawnFromFileA[side] + maxPawnFromFileH[side] - 5) / 2;
+                pawns->span[side] = max(0, maxPawnFromFileA + maxPawnFromFileH - 5) / 2;
         }
 
+        // From here on, look at the pawns relative to the own first rank
+        uint64_t relative[2] = { pawnSet[white], flipRanks(pawnSet[black]) }; // [side]
+
         // Pawn features
-        for (int file=0; file<8; file++) {
-                evaluatePawnFile(self, v, pawns, file, white, maxPawnFromFirst);
-                evaluatePawnFile(self, v, pawns, file, black, maxPawnFromFirst);
-        }
+        evaluatePawns(self, v, pawns, white, relative[white], flipRanks(relative[black]));
+        evaluatePawns(self, v, pawns, black, relative[black], flipRanks(relative[white]));
 
         // Pawn shelter for king safety
         for (int side=white; side<=black; side++) {
@@ -747,9 +952,9 @@ static void extractPawnStructure(Board_t self, const int v[vectorLen], struct pk
                 int target = kingZoneCenter[king];
                 int kFlag = self->castleFlags & (castleFlagWhiteKside << side);
                 int qFlag = self->castleFlags & (castleFlagWhiteQside << side);
-                int shelter = shelterPenalty(v, side, file(target), maxPawnFromFirst);
-                int kShelter = kFlag ? shelterPenalty(v, side, fileG, maxPawnFromFirst) : shelter;
-                int qShelter = qFlag ? shelterPenalty(v, side, fileB, maxPawnFromFirst) : shelter;
+                int shelter = shelterPenalty(v, file(target), relative[side]);
+                int kShelter = kFlag ? shelterPenalty(v, fileG, relative[side]) : shelter;
+                int qShelter = qFlag ? shelterPenalty(v, fileB, relative[side]) : shelter;
                 int best = min(shelter, min(kShelter, qShelter));
                 shelter -= (v[shelterCastled] * (shelter - best)) >> 8; // (1-w)*S + w*B == S - w*(S-B)
                 pawns->shelter[side] = shelter;
@@ -760,173 +965,136 @@ static void extractPawnStructure(Board_t self, const int v[vectorLen], struct pk
 }
 
 /*----------------------------------------------------------------------+
- |      evaluatePawnFile                                                |
+ |      evaluatePawns                                                   |
  +----------------------------------------------------------------------*/
 
-// Helper for extractPawnStructure
-static void evaluatePawnFile(Board_t self, const int v[vectorLen], struct pkSlot *pawns, int file, int side,
-                             int maxPawnFromFirst[2][10][2])
+/*
+ *  Helper for extractPawnStructure. Both pawn sets are oriented as seen
+ *  by `side', so that its pawns always move north. Only the first and
+ *  last pawn of each file serve as helpers or sentries.
+ */
+static void evaluatePawns(Board_t self, const int v[vectorLen], struct pkSlot *pawns, int side,
+                          uint64_t own, uint64_t opp)
 {
-        #define maxRank(i, j)     ( maxPawnFromFirst[side ][1+file+(i)][j] )
-        #define minRank(i, j) flip( maxPawnFromFirst[xside][1+file+(i)][j] )
-
-        int xside = other(side);
-        int frontPawn = maxRank(0, side);
-        int backPawn  = minRank(0, side);
-
-        if (backPawn > frontPawn)
-                return; // No pawn on this file
-
-        pawns->pawnOnFile[side] |= bit(file);
-
         // Feature extraction
-        int fileIndex = fileIndex(self, file, side);
-        int firstHelper = min(minRank(-1, side),  minRank(+1, side));
-        int lastSentry  = max(maxRank(-1, xside), maxRank(+1, xside));
-        int firstSentry = min(minRank(-1, xside), minRank(+1, xside));
-        int pawnZone = ones(8) & ~bit(7) & ~bit(0);
-        int helperW  = ((1 << minRank(-1, side))  | (1 << maxRank(-1, side)))  & pawnZone;
-        int helperE  = ((1 << minRank(+1, side))  | (1 << maxRank(+1, side)))  & pawnZone;
-        int sentryW  = ((1 << minRank(-1, xside)) | (1 << maxRank(-1, xside))) & pawnZone;
-        int sentryE  = ((1 << minRank(+1, xside)) | (1 << maxRank(+1, xside))) & pawnZone;
-        int xPawns   = ((1 << minRank( 0, xside)) | (1 << maxRank( 0, xside))) & pawnZone;
-        int frontSpan = (~0 << (frontPawn + 1)) & ones(8);
-        int helperControl = (helperW | helperE) << 1;
-        int sentryControl = (sentryW | sentryE) >> 1;
-        bool openFile = !(xPawns & frontSpan);
-        bool isRammed = bitTest(xPawns,        frontPawn + 1);
-        bool isDuo    = bitTest(helperControl, frontPawn + 1);
-        bool stopSquareAttacked = bitTest(sentryControl, frontPawn + 1);
-        bool isDefended = bitTest(helperControl, frontPawn);
-        bool canCapture = bitTest(sentryControl, frontPawn); // == isAttacked
-        bool isTrailing = firstHelper > frontPawn;
-        bool isDoubled = backPawn < frontPawn;
-        int neighbours = (maxRank(-1, side) > 0) + (maxRank(+1, side) > 0);
-        int firstXpawn = minRank(0, xside);
-
-        // Scoring
-        int pawnScore = 0;
-
-        // First order
-        if (openFile)           pawnScore += v[openFilePawn_0 + frontPawn - 1];
-        if (isRammed)           pawnScore += v[rammedPawn_0   + frontPawn - 1];
-        if (canCapture)         pawnScore += v[capturePawn_0  + frontPawn - 1];
-        if (isDefended)         pawnScore += v[defendedPawn_0 + frontPawn - 1];
-        if (stopSquareAttacked) pawnScore += v[stoppedPawn_0  + frontPawn - 1];
-        if (isDuo)              pawnScore += v[duoPawn_0      + frontPawn - 1];
-        if (isTrailing)         pawnScore += v[trailingPawn_0 + frontPawn - 1];
-        if (isDoubled)          pawnScore += v[doubledPawnA   + fileIndex];
-        if (isDuo)              pawnScore += v[duoPawnA       + fileIndex];
-
-        // File and rank dependent scoring
-        int offset = oppKings(self) ? pawnByFile_0x : pawnByFile_0;
-        if (fileIndex > 0) pawnScore -= v[offset + fileIndex - 1];
-        if (fileIndex < 7) pawnScore += v[offset + fileIndex];
-        if (frontPawn > 1) pawnScore -= v[pawnByRank_0 + frontPawn - 2];
-        if (frontPawn < 6) pawnScore += v[pawnByRank_0 + frontPawn - 1];
-
-        // Pawn mobility
-        if (!isRammed && !stopSquareAttacked)
-                pawnScore += v[mobilePawn_0 + frontPawn - 1];
-
-        // Backward
-        if (isTrailing && stopSquareAttacked && !canCapture) {
-                pawnScore += v[(openFile ? backwardPawnOpenA : backwardPawnClosedA) + fileIndex];
-                if (openFile) {
-                        if (frontPawn > 2) pawnScore -= v[backwardPawnOpenByRank_0 + frontPawn - 2];
-                        if (frontPawn < 6) pawnScore += v[backwardPawnOpenByRank_0 + frontPawn - 1];
-                        pawns->weakPawnOnFile[side] |= bit(file);
-                } else {
-                        if (frontPawn > 2) pawnScore -= v[backwardPawnClosedByRank_0 + frontPawn - 2];
-                        if (frontPawn < 6) pawnScore += v[backwardPawnClosedByRank_0 + frontPawn - 1];
+        uint64_t frontPawns = lastPawns(own);
+        uint64_t ownOuter = (firstPawns(own) | frontPawns) & pawnZone;
+        uint64_t oppOuter = (firstPawns(opp) | lastPawns(opp)) & pawnZone;
+        uint64_t helperW  = ownOuter << 8, helperE = ownOuter >> 8;
+        uint64_t sentryW  = oppOuter << 8, sentryE = oppOuter >> 8;
+        uint64_t helpers  = helperW | helperE;
+        uint64_t sentries = sentryW | sentryE;
+        uint64_t frontSpans = fillNorth(north(frontPawns));
+
+        uint64_t openFile   = frontPawns & ~fillSouth(south(oppOuter));
+        uint64_t isRammed   = frontPawns & south(oppOuter);
+        uint64_t isDuo      = frontPawns & helpers;
+        uint64_t stopSquareAttacked = frontPawns & south(south(sentries));
+        uint64_t isDefended = frontPawns & north(helpers);
+        uint64_t canCapture = frontPawns & south(sentries); // == isAttacked
+        uint64_t isTrailing = frontPawns & ~fillNorth((own << 8) | (own >> 8));
+        uint64_t isDoubled  = frontPawns & fillNorth(north(own));
+        uint64_t isPasser   = openFile & ~fillSouth(south((opp << 8) | (opp >> 8)));
+
+        uint64_t stoppedByOne = frontSpans & south(sentryW ^ sentryE) & ~north(helpers);
+        uint64_t stoppedByTwo = frontSpans & south(sentryW & sentryE) & ~north(helperW & helperE);
+        uint64_t isCandidate = openFile & ~isPasser & ~fillSouth(stoppedByOne | stoppedByTwo);
+
+        for (int file=fileA; file<=fileH; file++) {
+                int frontBit = fileBits(frontPawns, file);
+                if (!frontBit)
+                        continue; // No pawn on this file
+
+                pawns->pawnOnFile[side] |= bit(file);
+
+                int frontPawn = bitIndex8(frontBit);
+                int square = square(file, frontPawn);
+                int fileIndex = fileIndex(self, file, side);
+                int neighbours = ((fileBits(own, file - 1) & ~1) != 0)
+                               + ((fileBits(own, file + 1) & ~1) != 0);
+
+                // Scoring
+                int pawnScore = 0;
+
+                // First order
+                if (bitTest(openFile, square))           pawnScore += v[openFilePawn_0 + frontPawn - 1];
+                if (bitTest(isRammed, square))           pawnScore += v[rammedPawn_0   + frontPawn - 1];
+                if (bitTest(canCapture, square))         pawnScore += v[capturePawn_0  + frontPawn - 1];
+                if (bitTest(isDefended, square))         pawnScore += v[defendedPawn_0 + frontPawn - 1];
+                if (bitTest(stopSquareAttacked, square)) pawnScore += v[stoppedPawn_0  + frontPawn - 1];
+                if (bitTest(isDuo, square))              pawnScore += v[duoPawn_0      + frontPawn - 1];
+                if (bitTest(isTrailing, square))         pawnScore += v[trailingPawn_0 + frontPawn - 1];
+                if (bitTest(isDoubled, square))          pawnScore += v[doubledPawnA   + fileIndex];
+                if (bitTest(isDuo, square))              pawnScore += v[duoPawnA       + fileIndex];
+
+                // File and rank dependent scoring
+                int offset = oppKings(self) ? pawnByFile_0x : pawnByFile_0;
+                if (fileIndex > 0) pawnScore -= v[offset + fileIndex - 1];
+                if (fileIndex < 7) pawnScore += v[offset + fileIndex];
+                if (frontPawn > 1) pawnScore -= v[pawnByRank_0 + frontPawn - 2];
+                if (frontPawn < 6) pawnScore += v[pawnByRank_0 + frontPawn - 1];
+
+                // Pawn mobility
+                if (!bitTest(isRammed | stopSquareAttacked, square))
+                        pawnScore += v[mobilePawn_0 + frontPawn - 1];
+
+                // Backward
+                if (bitTest(isTrailing & stopSquareAttacked & ~canCapture, square)) {
+                        if (bitTest(openFile, square)) {
+                                pawnScore += v[backwardPawnOpenA + fileIndex];
+                                if (frontPawn > 2) pawnScore -= v[backwardPawnOpenByRank_0 + frontPawn - 2];
+                                if (frontPawn < 6) pawnScore += v[backwardPawnOpenByRank_0 + frontPawn - 1];
+                                pawns->weakPawnOnFile[side] |= bit(file);
+                        } else {
+                                pawnScore += v[backwardPawnClosedA + fileIndex];
+                                if (frontPawn > 2) pawnScore -= v[backwardPawnClosedByRank_0 + frontPawn - 2];
+                                if (frontPawn < 6) pawnScore += v[backwardPawnClosedByRank_0 + frontPawn - 1];
+                        }
                 }
-        }
 
-        // Rammed and weak
-        if (isTrailing && isRammed && !canCapture)
-                pawnScore += v[rammedWeakPawnA + fileIndex];
-
-        // Isolated, middle or end of group
-        static const int offsets[3][2] = {
-                { isolatedPawnClosedA, isolatedPawnOpenA },
-                { sidePawnClosedA,     sidePawnOpenA     },
-                { middlePawnClosedA,   middlePawnOpenA   } };
-        pawnScore += v[offsets[neighbours][openFile] + fileIndex];
-
-        // Passer
-        if (openFile && lastSentry <= frontPawn) {
-                pawns->passerOnFile[side] |= bit(file);
-                int nominal = v[passerA_0 + fileIndex]
-                            + v[passerA_1 + fileIndex] * (frontPawn - 1)
-                            + v[passerA_2 + fileIndex] * (frontPawn - 1) * (frontPawn - 2) / 4;
-                if (isDefended) nominal += v[protectedPasser];
-                if (isDuo)      nominal += v[connectedPasser];
-                pawns->passerScore[side] += nominal;
-        }
-        // TODO: scoring by square (no polynomials)
-        // TODO: passer is doubled penalty
-
-        // Candidate
-        if (openFile && lastSentry > frontPawn) {
-                int oneSentry = (sentryW ^ sentryE) >> 1;
-                int twoSentry = (sentryW & sentryE) >> 1;
-                int anyHelper = (helperW | helperE) << 1;
-                int twoHelper = (helperW & helperE) << 1;
-                int stoppedByOne = frontSpan & oneSentry & ~anyHelper;
-                int stoppedByTwo = frontSpan & twoSentry & ~twoHelper;
+                // Rammed and weak
+                if (bitTest(isTrailing & isRammed & ~canCapture, square))
+                        pawnScore += v[rammedWeakPawnA + fileIndex];
+
+                // Isolated, middle or end of group
+                static const int offsets[3][2] = {
+                        { isolatedPawnClosedA, isolatedPawnOpenA },
+                        { sidePawnClosedA,     sidePawnOpenA     },
+                        { middlePawnClosedA,   middlePawnOpenA   } };
+                pawnScore += v[offsets[neighbours][bitTest(openFile, square)] + fileIndex];
+
+                // Passer
+                if (bitTest(isPasser, square)) {
+                        pawns->passerOnFile[side] |= bit(file);
+                        int nominal = v[passerA_0 + fileIndex]
+                                    + v[passerA_1 + fileIndex] * (frontPawn - 1)
+                                    + v[passerA_2 + fileIndex] * (frontPawn - 1) * (frontPawn - 2) / 4;
+                        if (bitTest(isDefended, square)) nominal += v[protectedPasser];
+                        if (bitTest(isDuo, square))      nominal += v[connectedPasser];
+                        pawns->passerScore[side] += nominal;
+                }
                 // TODO: scoring by square (no polynomials)
-                // TODO: scale by number of sentries to overcome (1,2,3-4)
+                // TODO: passer is doubled penalty
 
-                if (!stoppedByOne && !stoppedByTwo) {
+                // Candidate
+                // TODO: scale by number of sentries to overcome (1,2,3-4)
+                if (bitTest(isCandidate, square)) {
                         assert(frontPawn < 6);
                         int nominal = v[candidateByRank_0 + frontPawn - 1]
                                     + v[candidateA + fileIndex];
                         pawns->passerScore[side] += nominal;
                 }
-        }
-
-#if 0
-        // Sneaker
-        if (isRammed && lastSentry <= frontPawn) {
-                // - - -   - - -
-                // - * -   - * -
-                // - O -   x O -
-                // - - -   x - -
-                // - - O   O - -
-                // - - -   x - -
-                // - - -   o - -
-                // - - -   x - -
-                int blockers = frontSpan & xPawns;
-                int blocker = blockers & -blockers;
-                if (blocker == blockers) { // only one blocker
-                        blocker -= 1; // ranks where we want to find a helper
-
-                        if (helperW & blocker)
-                        if (helperE & blocker)
-                }
-        }
-#endif
 
-        // Can make a lever
-        // TODO: use bitwise logic
-        if (frontPawn + 1 < firstSentry && firstSentry <= firstXpawn && firstXpawn < 7)
-                pawnScore += v[pawnLever_0 + firstSentry - frontPawn];
+                // Can make a lever
+                int sentryBits = fileBits(opp, file - 1) | fileBits(opp, file + 1);
+                int xPawnBits = fileBits(opp, file);
+                int firstSentry = sentryBits ? bitIndex8(sentryBits & -sentryBits) : 7;
+                int firstXpawn = xPawnBits ? bitIndex8(xPawnBits & -xPawnBits) : 7;
+                if (frontPawn + 1 < firstSentry && firstSentry <= firstXpawn && firstXpawn < 7)
+                        pawnScore += v[pawnLever_0 + firstSentry - frontPawn];
 
-#if 0
-        // Potential open file (good for rooks)
-        if (openFile && lastSentry > frontPawn && !isDoubled) {
-                #define firstBit(w) ((w) & -(w))
-                int rank = firstBit(sentryControl & frontSpan);
-                assert(rank != 0);
-                if ((((sentryW ^ sentryE) >> 1) | helperControl) & rank)
-                        pawnFlags |= pawnFlagPotentialOpen;
+                pawns->wiloScore[side] += pawnScore;
         }
-
-        pawns->pawnFlags[side][pawns->nrPawns[side]++] = pawnFlags;
-        assert(pawns->nrPawns[side] < 8);
-#endif
-
-        pawns->wiloScore[side] += pawnScore;
 }
 
 /*----------------------------------------------------------------------+
@@ -1157,12 +1325,13 @@ static int evaluateQueen(Board_t self, const int v[vectorLen], const struct pkSl
  |      evaluateKing                                                    |
  +----------------------------------------------------------------------*/
 
-static int shelterPenalty(const int v[vectorLen], int side, int file, int maxPawnFromFirst[2][10][2])
+static int shelterPenalty(const int v[vectorLen], int file, uint64_t own)
 {
         int sum = 0;
 
         for (int i=-1; i<=1; i++) {
-                int j = maxPawnFromFirst[other(side)][1+file+i][side];
+                int pawnBits = fileBits(own, file + i);
+                int j = pawnBits ? 7 - bitIndex8(pawnBits & -pawnBits) : 0;
                 if (j < 6) sum += v[shelterPawn_5-j];
         }
 
@@ -1204,6 +1373,45 @@ static double logit(double p)
         return log(p / (1.0 - p));
 }
 
+/*----------------------------------------------------------------------+
+ |      Pawn set operations                                             |
+ +----------------------------------------------------------------------*/
+
+// Extend each pawn along its file up to the last rank
+static uint64_t fillNorth(uint64_t set)
+{
+        set |= (set << 1) & 0xfefefefefefefefeULL;
+        set |= (set << 2) & 0xfcfcfcfcfcfcfcfcULL;
+        set |= (set << 4) & 0xf0f0f0f0f0f0f0f0ULL;
+        return set;
+}
+
+// Extend each pawn along its file down to the first rank
+static uint64_t fillSouth(uint64_t set)
+{
+        set |= (set >> 1) & 0x7f7f7f7f7f7f7f7fULL;
+        set |= (set >> 2) & 0x3f3f3f3f3f3f3f3fULL;
+        set |= (set >> 4) & 0x0f0f0f0f0f0f0f0fULL;
+        return set;
+}
+
+// Mirror the board vertically (swap the ranks within every file)
+static uint64_t flipRanks(uint64_t set)
+{
+        set = ((set >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((set & 0x0f0f0f0f0f0f0f0fULL) << 4);
+        set = ((set >> 2) & 0x3333333333333333ULL) | ((set & 0x3333333333333333ULL) << 2);
+        set = ((set >> 1) & 0x5555555555555555ULL) | ((set & 0x5555555555555555ULL) << 1);
+        return set;
+}
+
+static int popCount(uint64_t set)
+{
+        set -= (set >> 1) & 0x5555555555555555ULL;
+        set = (set & 0x3333333333333333ULL) + ((set >> 2) & 0x3333333333333333ULL);
+        set = (set + (set >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+        return (int) ((set * 0x0101010101010101ULL) >> 56);
+}
+
 /*----------------------------------------------------------------------+
  |      squareOf                                                        |
  +----------------------------------------------------------------------*/
@@ -48,6 +48,8 @@ int main(void)
                "\n"
                "Type \"help\" for more information, or \"quit\" to leave.\n\n");
 
+        initPawnKingHash();
+
         struct Engine engine;
         initEngine(&engine);
 
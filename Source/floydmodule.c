@@ -40,10 +40,13 @@
 
 // Python API (must come first)
 #include "Python.h"
+#include "pythread.h"
+#include "structseq.h"
 
 // C standard
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 // C extension
 #include "cplus.h"
@@ -51,6 +54,7 @@
 // Other modules
 #include "Board.h"
 #include "Engine.h"
+#include "kpk.h"
 #include "uci.h"
 
 /*----------------------------------------------------------------------+
@@ -60,31 +64,241 @@
 // Module docstring
 PyDoc_STRVAR(floyd_doc, "Chess engine study");
 
+// Held while the default vector is in use without the GIL
+static PyThread_type_lock defaultVectorLock;
+
+/*----------------------------------------------------------------------+
+ |      Vector type                                                     |
+ +----------------------------------------------------------------------*/
+
+PyDoc_STRVAR(Vector_doc,
+        "Vector(values=None) -> evaluation vector with its own caches\n"
+        "\n"
+        "A new vector starts as a copy of the default vector, or of `values'.\n"
+        "It supports len(), indexing and the buffer protocol (format 'i'),\n"
+        "for example memoryview(vector) for bulk access. Pass it to evaluate()\n"
+        "or search() to use it instead of the default vector. These calls\n"
+        "release the GIL, so threads with different vectors run in parallel.\n"
+        "Don't write through a buffer while the vector is in use by a call.\n"
+);
+
+typedef struct {
+        PyObject_HEAD
+        Vector_t vector;
+        PyThread_type_lock lock; // Held while in use without the GIL
+        Py_ssize_t shape[1];     // For the buffer protocol
+} VectorObject;
+
+static PyTypeObject VectorType;
+
+static void
+Vector_dealloc(VectorObject *self)
+{
+        freeVector(self->vector);
+        if (self->lock)
+                PyThread_free_lock(self->lock);
+        Py_TYPE(self)->tp_free((PyObject*) self);
+}
+
+static int
+Vector_ass_item(VectorObject *self, Py_ssize_t coef, PyObject *value);
+
+static PyObject *
+Vector_new(PyTypeObject *type, PyObject *args, PyObject *keywords)
+{
+        PyObject *values = null;
+        static char *keywordList[] = { "values", null };
+
+        if (!PyArg_ParseTupleAndKeywords(args, keywords, "|O:Vector", keywordList, &values))
+                return null;
+
+        VectorObject *self = (VectorObject*) type->tp_alloc(type, 0);
+        if (!self)
+                return null;
+
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(defaultVectorLock, WAIT_LOCK); // For copying it
+        self->vector = newVector();
+        PyThread_release_lock(defaultVectorLock);
+        Py_END_ALLOW_THREADS
+        self->lock = PyThread_allocate_lock();
+        self->shape[0] = vectorLen;
+        if (!self->vector || !self->lock) {
+                Py_DECREF(self);
+                return PyErr_NoMemory();
+        }
+
+        if (values != null) {
+                PyObject *sequence = PySequence_Fast(values, "values must be a sequence");
+                if (!sequence) {
+                        Py_DECREF(self);
+                        return null;
+                }
+                if (PySequence_Fast_GET_SIZE(sequence) != vectorLen) {
+                        Py_DECREF(sequence);
+                        Py_DECREF(self);
+                        return PyErr_Format(PyExc_ValueError, "values must have length %d", vectorLen);
+                }
+                for (int coef=0; coef<vectorLen; coef++)
+                        if (Vector_ass_item(self, coef, PySequence_Fast_GET_ITEM(sequence, coef))) {
+                                Py_DECREF(sequence);
+                                Py_DECREF(self);
+                                return null;
+                        }
+                Py_DECREF(sequence);
+        }
+
+        return (PyObject*) self;
+}
+
+static Py_ssize_t
+Vector_length(VectorObject *self)
+{
+        unused(self);
+        return vectorLen;
+}
+
+static PyObject *
+Vector_item(VectorObject *self, Py_ssize_t coef)
+{
+        if (coef < 0 || coef >= vectorLen)
+                return PyErr_Format(PyExc_IndexError, "coef %zd out of range", coef);
+        return PyInt_FromLong(vectorCoefficients(self->vector)[coef]);
+}
+
+static int
+Vector_ass_item(VectorObject *self, Py_ssize_t coef, PyObject *value)
+{
+        if (coef < 0 || coef >= vectorLen) {
+                PyErr_Format(PyExc_IndexError, "coef %zd out of range", coef);
+                return -1;
+        }
+        if (value == null) {
+                PyErr_SetString(PyExc_TypeError, "Vector items can't be deleted");
+                return -1;
+        }
+        long newValue = PyInt_AsLong(value);
+        if (newValue == -1 && PyErr_Occurred())
+                return -1;
+
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->lock, WAIT_LOCK);
+        setCoefficient(self->vector, coef, newValue);
+        PyThread_release_lock(self->lock);
+        Py_END_ALLOW_THREADS
+        return 0;
+}
+
+static int
+Vector_getbuffer(VectorObject *self, Py_buffer *view, int flags)
+{
+        view->buf = vectorCoefficients(self->vector);
+        view->obj = (PyObject*) self;
+        Py_INCREF(self);
+        view->len = vectorLen * sizeof(int);
+        view->readonly = 0;
+        view->itemsize = sizeof(int);
+        view->format = (flags & PyBUF_FORMAT) ? "i" : null;
+        view->ndim = 1;
+        view->shape = (flags & PyBUF_ND) ? self->shape : null;
+        view->strides = (flags & PyBUF_STRIDES) ? &view->itemsize : null;
+        view->suboffsets = null;
+        view->internal = null;
+        return 0;
+}
+
+// Old style buffer interface, for ctypes and array in Python 2
+static Py_ssize_t
+Vector_getsegment(VectorObject *self, Py_ssize_t segment, void **pointer)
+{
+        if (segment != 0) {
+                PyErr_SetString(PyExc_SystemError, "accessing non-existent Vector segment");
+                return -1;
+        }
+        *pointer = vectorCoefficients(self->vector);
+        return vectorLen * sizeof(int);
+}
+
+static Py_ssize_t
+Vector_getsegcount(VectorObject *self, Py_ssize_t *lenp)
+{
+        unused(self);
+        if (lenp)
+                *lenp = vectorLen * sizeof(int);
+        return 1;
+}
+
+static PySequenceMethods Vector_as_sequence = {
+        .sq_length = (lenfunc) Vector_length,
+        .sq_item = (ssizeargfunc) Vector_item,
+        .sq_ass_item = (ssizeobjargproc) Vector_ass_item,
+};
+
+static PyBufferProcs Vector_as_buffer = {
+        .bf_getreadbuffer = (readbufferproc) Vector_getsegment,
+        .bf_getwritebuffer = (writebufferproc) Vector_getsegment,
+        .bf_getsegcount = (segcountproc) Vector_getsegcount,
+        .bf_getbuffer = (getbufferproc) Vector_getbuffer,
+};
+
+static PyTypeObject VectorType = {
+        PyVarObject_HEAD_INIT(null, 0)
+        .tp_name = "floyd.Vector",
+        .tp_basicsize = sizeof(VectorObject),
+        .tp_dealloc = (destructor) Vector_dealloc,
+        .tp_as_sequence = &Vector_as_sequence,
+        .tp_as_buffer = &Vector_as_buffer,
+        .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER,
+        .tp_doc = Vector_doc,
+        .tp_new = Vector_new,
+};
+
+// Claim a vector for use without the GIL. Null means the default vector
+static Vector_t lockVector(VectorObject *vector)
+{
+        PyThread_acquire_lock(vector ? vector->lock : defaultVectorLock, WAIT_LOCK);
+        Vector_t cVector = vector ? vector->vector : null;
+        syncVector(cVector); // Catch changes through the buffer
+        return cVector;
+}
+
+static void unlockVector(VectorObject *vector)
+{
+        PyThread_release_lock(vector ? vector->lock : defaultVectorLock);
+}
+
 /*----------------------------------------------------------------------+
  |      evaluate(...)                                                   |
  +----------------------------------------------------------------------*/
 
 PyDoc_STRVAR(evaluate_doc,
-        "evaluate(fen) -> score\n"
+        "evaluate(fen, vector=None) -> score\n"
 );
 
 static PyObject *
-floydmodule_evaluate(PyObject *self, PyObject *args)
+floydmodule_evaluate(PyObject *self, PyObject *args, PyObject *keywords)
 {
         unused(self);
         char *fen;
+        VectorObject *vector = null;
+
+        static char *keywordList[] = { "fen", "vector", null };
 
-        if (!PyArg_ParseTuple(args, "s", &fen))
+        if (!PyArg_ParseTupleAndKeywords(args, keywords, "s|O!:evaluate", keywordList,
+                &fen, &VectorType, &vector))
                 return null;
 
-        struct Board board;
+        struct Board board = { .vector = null };
         int len = setupBoard(&board, fen);
         if (len <= 0)
                 return PyErr_Format(PyExc_ValueError, "Invalid FEN (%s)", fen);
 
-        if (globalVectorChanged)
-                resetEvaluate();
-        int score = evaluate(&board);
+        int score;
+        Py_BEGIN_ALLOW_THREADS
+        board.vector = lockVector(vector);
+        score = evaluate(&board);
+        unlockVector(vector);
+        Py_END_ALLOW_THREADS
 
         return PyFloat_FromDouble(score / 1000.0);
 }
@@ -93,13 +307,10 @@ floydmodule_evaluate(PyObject *self, PyObject *args)
  |      setCoefficient(...)                                             |
  +----------------------------------------------------------------------*/
 
-// TODO: create a proper object for the vector
-// TODO: create coef name list
-
 PyDoc_STRVAR(setCoefficient_doc,
         "setCoefficient(coef, newValue) -> oldValue, name\n"
         "\n"
-        "!!! EXPERIMENTAL !!!\n"
+        "Change a coefficient of the default vector\n"
 );
 
 static PyObject *
@@ -114,9 +325,12 @@ floydmodule_setCoefficient(PyObject *self, PyObject *args)
         if (coef < 0 || coef >= vectorLen)
                 return PyErr_Format(PyExc_IndexError, "coef %d out of range", coef);
 
-        long oldValue = globalVector[coef];
-        globalVector[coef] = newValue;
-        globalVectorChanged |= (newValue != oldValue); // invalidate evaluation caches
+        long oldValue;
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(defaultVectorLock, WAIT_LOCK);
+        oldValue = setCoefficient(null, coef, newValue);
+        PyThread_release_lock(defaultVectorLock);
+        Py_END_ALLOW_THREADS
 
         PyObject *result = PyTuple_New(2);
         if (!result)
@@ -135,16 +349,202 @@ floydmodule_setCoefficient(PyObject *self, PyObject *args)
         return result;
 }
 
+/*----------------------------------------------------------------------+
+ |      getSearchParameter(...) / setSearchParameter(...)               |
+ +----------------------------------------------------------------------*/
+
+static int findSearchParameter(const char *name)
+{
+        for (int i=0; i<searchVectorLen; i++)
+                if (!strcmp(name, searchLabels[i]))
+                        return i;
+        PyErr_Format(PyExc_KeyError, "Unknown search parameter (%s)", name);
+        return -1;
+}
+
+PyDoc_STRVAR(getSearchParameter_doc,
+        "getSearchParameter(name) -> value\n"
+);
+
+static PyObject *
+floydmodule_getSearchParameter(PyObject *self, PyObject *args)
+{
+        unused(self);
+        char *name;
+
+        if (!PyArg_ParseTuple(args, "s", &name))
+                return null;
+
+        int i = findSearchParameter(name);
+        return (i < 0) ? null : PyInt_FromLong(searchVector[i]);
+}
+
+PyDoc_STRVAR(setSearchParameter_doc,
+        "setSearchParameter(name, newValue) -> oldValue\n"
+        "\n"
+        "See Source/params.h for the available parameters\n"
+);
+
+static PyObject *
+floydmodule_setSearchParameter(PyObject *self, PyObject *args)
+{
+        unused(self);
+        char *name;
+        int newValue;
+
+        if (!PyArg_ParseTuple(args, "si", &name, &newValue))
+                return null;
+
+        int i = findSearchParameter(name);
+        if (i < 0)
+                return null;
+
+        long oldValue = searchVector[i];
+        searchVector[i] = newValue;
+        return PyInt_FromLong(oldValue);
+}
+
+/*----------------------------------------------------------------------+
+ |      SearchResult type                                               |
+ +----------------------------------------------------------------------*/
+
+PyDoc_STRVAR(SearchResult_doc,
+        "Result of search(). Unpacks as score, move. The other fields\n"
+        "are only available by name.\n"
+);
+
+static PyStructSequence_Field searchResultFields[] = {
+        { "score",      "Score in pawns from the side to move" },
+        { "move",       "Best move in UCI notation, or None" },
+        { "depth",      "Depth of the last completed iteration" },
+        { "nodes",      "Number of nodes searched" },
+        { "time",       "Search time in seconds" },
+        { "mate",       "Moves to mate, negative when being mated, or None" },
+        { "pv",         "Principal variation in UCI notation" },
+        { "pvSan",      "Principal variation in SAN" },
+        { "depthNodes", "Number of nodes after each iteration" },
+        { null, null }
+};
+
+static PyStructSequence_Desc searchResultDesc = {
+        "floyd.SearchResult", SearchResult_doc, searchResultFields, 2
+};
+
+static PyTypeObject SearchResultType;
+
+// Info function data of search()
+struct resultInfo {
+        Engine_t engine;
+        searchInfo_fn *infoFunction; // For passing on
+        int depth; // Last completed iteration, or -1
+        long long depthNodes[maxDepth+1];
+};
+
+static void resultInfo(void *infoData)
+{
+        struct resultInfo *self = infoData;
+        if (!self->engine->aborted) {
+                self->depth = self->engine->depth;
+                self->depthNodes[self->depth] = self->engine->nodeCount;
+        }
+        self->infoFunction(self->engine);
+}
+
+// Principal variation as a tuple of moves, in UCI notation or in SAN
+static PyObject *pvTuple(Engine_t engine, bool san)
+{
+        Board_t board = &engine->board;
+        PyObject *pv = PyTuple_New(engine->pv.len);
+        int i;
+        for (i=0; pv && i<engine->pv.len; i++) {
+                int move = engine->pv.v[i];
+                char moveString[maxMoveSize];
+                if (san) {
+                        int moveList[maxMoves];
+                        int nrMoves = generateMoves(board, moveList, generateAll);
+                        moveToSan(board, moveString, move, moveList, nrMoves);
+                } else
+                        moveToUci(moveString, move);
+                PyObject *item = PyString_FromString(moveString);
+                if (!item) {
+                        Py_CLEAR(pv);
+                        break;
+                }
+                PyTuple_SET_ITEM(pv, i, item);
+                makeMove(board, move);
+        }
+        while (i-- > 0)
+                undoMove(board);
+        return pv;
+}
+
+static PyObject *newSearchResult(Engine_t engine, int depth, const long long depthNodes[])
+{
+        PyObject *result = PyStructSequence_New(&SearchResultType);
+        if (!result)
+                return null;
+
+        PyObject *move = Py_None, *mate = Py_None;
+        if (engine->bestMove != 0) {
+                char moveString[maxMoveSize];
+                moveToUci(moveString, engine->bestMove);
+                move = PyString_FromString(moveString);
+        } else
+                Py_INCREF(Py_None);
+
+        if (isMateScore(engine->score))
+                mate = PyInt_FromLong((engine->score < 0) ? (minMate - engine->score    ) / 2
+                                                          : (maxMate - engine->score + 1) / 2);
+        else
+                Py_INCREF(Py_None);
+
+        PyObject *nodesList = PyTuple_New(depth + 1);
+        for (int i=0; nodesList && i<=depth; i++) {
+                PyObject *nodes = PyLong_FromLongLong(depthNodes[i]);
+                if (!nodes) {
+                        Py_CLEAR(nodesList);
+                        break;
+                }
+                PyTuple_SET_ITEM(nodesList, i, nodes);
+        }
+
+        PyObject *items[] = {
+                PyFloat_FromDouble(engine->score / 1000.0),
+                move,
+                PyInt_FromLong(depth),
+                PyLong_FromLongLong(engine->nodeCount),
+                PyFloat_FromDouble(engine->seconds),
+                mate,
+                pvTuple(engine, false),
+                pvTuple(engine, true),
+                nodesList,
+        };
+
+        bool ok = true;
+        for (int i=0; i<arrayLen(items); i++) {
+                ok = ok && items[i];
+                PyStructSequence_SET_ITEM(result, i, items[i]); // Null is allowed
+        }
+        if (!ok)
+                Py_CLEAR(result);
+        return result;
+}
+
 /*----------------------------------------------------------------------+
  |      search(...)                                                     |
  +----------------------------------------------------------------------*/
 
 PyDoc_STRVAR(search_doc,
-        "search(fen, depth=" quote2(maxDepth) ", movetime=0.0, info=None) -> score, move\n"
+        "search(fen, depth=" quote2(maxDepth) ", movetime=0.0, info=None, samples=None,\n"
+        "       vector=None) -> SearchResult(score, move, depth, nodes, time, mate,\n"
+        "                                     pv, pvSan, depthNodes)\n"
+        "The result unpacks as `score, move'.\n"
         "Valid options for `info' are:\n"
         "       None    : No info\n"
         "       'uci'   : Write UCI info lines to stdout\n"
 //      "       'xboard': Write XBoard info lines to stdout\n"
+        "When `samples' is a file name, search samples are appended to it\n"
+        "for fitting pruning margins (see Tools/futility.py)\n"
 );
 
 static PyObject *
@@ -155,24 +555,15 @@ floydmodule_search(PyObject *self, PyObject *args, PyObject *keywords)
         int depth = maxDepth;
         double movetime = 0.0;
         char *info = null;
+        char *samples = null;
+        VectorObject *vector = null;
 
-        static char *keywordList[] = { "fen", "depth", "movetime", "info", null };
+        static char *keywordList[] = { "fen", "depth", "movetime", "info", "samples", "vector", null };
 
-        if (!PyArg_ParseTupleAndKeywords(args, keywords, "s|idz:search", keywordList,
-                &fen, &depth, &movetime, &info))
+        if (!PyArg_ParseTupleAndKeywords(args, keywords, "s|idzzO!:search", keywordList,
+                &fen, &depth, &movetime, &info, &samples, &VectorType, &vector))
                 return null;
 
-        struct Engine engine;
-        initEngine(&engine);
-
-        ttSetSize(&engine, (depth > 0) ? 4*1024*1024 : 0); // TODO: remove when we have a proper engine object
-
-        int len = setupBoard(&engine.board, fen);
-        if (len <= 0)
-                return PyErr_Format(PyExc_ValueError, "Invalid FEN (%s)", fen);
-
-        engine.board.eloDiff = atoi(fen + len);
-
         if (depth < 0 || depth > maxDepth)
                 return PyErr_Format(PyExc_ValueError, "Invalid depth (%d)", depth);
 
@@ -180,7 +571,6 @@ floydmodule_search(PyObject *self, PyObject *args, PyObject *keywords)
                 return PyErr_Format(PyExc_ValueError, "Invalid movetime (%g)", movetime);
 
         searchInfo_fn *infoFunction = noInfoFunction;
-        void *infoData = &engine;
         if (info != null) {
                 if (!strcmp(info, "uci"))
                         infoFunction = uciSearchInfo;
@@ -188,49 +578,238 @@ floydmodule_search(PyObject *self, PyObject *args, PyObject *keywords)
                         return PyErr_Format(PyExc_ValueError, "Invalid info type (%s)", info);
         }
 
+        struct Engine engine;
+        initEngine(&engine);
+
+        ttSetSize(&engine, (depth > 0) ? 4*1024*1024 : 0); // TODO: remove when we have a proper engine object
+
+        int len = setupBoard(&engine.board, fen);
+        if (len <= 0) {
+                cleanupEngine(&engine);
+                return PyErr_Format(PyExc_ValueError, "Invalid FEN (%s)", fen);
+        }
+
+        engine.board.eloDiff = atoi(fen + len);
+
+        struct resultInfo infoData = { .engine = &engine, .infoFunction = infoFunction, .depth = -1 };
+
         engine.target.depth = depth;
         engine.target.nodeCount = maxLongLong;
         engine.target.scores = (intPair) {{ -maxInt, maxInt }};;
         engine.target.time = 0.0;
         engine.target.maxTime = movetime;
         engine.pondering = false;
-        engine.infoFunction = infoFunction;
-        engine.infoData = infoData;
+        engine.infoFunction = resultInfo;
+        engine.infoData = &infoData;
+
+        if (samples != null) {
+                engine.sampleFile = fopen(samples, "a");
+                if (!engine.sampleFile) {
+                        cleanupEngine(&engine);
+                        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, samples);
+                }
+        }
 
-        if (globalVectorChanged)
-                resetEvaluate();
+        Py_BEGIN_ALLOW_THREADS
+        engine.board.vector = lockVector(vector);
         rootSearch(&engine);
+        unlockVector(vector);
+        Py_END_ALLOW_THREADS
+        if (engine.sampleFile)
+                fclose(engine.sampleFile);
+
+        if (engine.interrupted) {
+                cleanupEngine(&engine);
+                PyErr_SetNone(PyExc_KeyboardInterrupt);
+                return null;
+        }
+
+        PyObject *result = newSearchResult(&engine, infoData.depth, infoData.depthNodes);
         cleanupEngine(&engine);
+        return result;
+}
+
+/*----------------------------------------------------------------------+
+ |      parseMove(...)                                                  |
+ +----------------------------------------------------------------------*/
+
+PyDoc_STRVAR(parseMove_doc,
+        "parseMove(fen, move) -> uci, san\n"
+        "\n"
+        "Parse a legal move in UCI notation or in SAN\n"
+);
+
+static PyObject *
+floydmodule_parseMove(PyObject *self, PyObject *args)
+{
+        unused(self);
+        char *fen, *moveText;
 
-        if (PyErr_Occurred())
+        if (!PyArg_ParseTuple(args, "ss:parseMove", &fen, &moveText))
                 return null;
 
-        PyObject *result = PyTuple_New(2);
-        if (!result)
+        struct Engine engine;
+        initEngine(&engine);
+
+        if (setupBoard(&engine.board, fen) <= 0) {
+                cleanupEngine(&engine);
+                return PyErr_Format(PyExc_ValueError, "Invalid FEN (%s)", fen);
+        }
+
+        Board_t board = &engine.board;
+        int moveList[maxMoves], move = -1;
+        int nrMoves = generateMoves(board, moveList, generateAll);
+        int n = parseUciMove(board, moveText, moveList, nrMoves, &move);
+        if (n <= 0)
+                n = parseSanMove(board, moveText, moveList, nrMoves, &move);
+        if (n > 0 && moveText[n + strspn(&moveText[n], " \t\n")] != '\0')
+                n = 0; // More than one move
+
+        char uci[maxMoveSize], san[maxMoveSize];
+        if (n > 0 && move > 0) {
+                moveToUci(uci, move);
+                moveToSan(board, san, move, moveList, nrMoves);
+        }
+        cleanupEngine(&engine);
+
+        if (n <= 0)
+                return PyErr_Format(PyExc_ValueError, "Invalid move (%s)", moveText);
+        if (move <= 0)
+                return PyErr_Format(PyExc_ValueError, "Illegal move (%s)", moveText);
+        return Py_BuildValue("(ss)", uci, san);
+}
+
+/*----------------------------------------------------------------------+
+ |      selfPlay(...)                                                   |
+ +----------------------------------------------------------------------*/
+
+PyDoc_STRVAR(selfPlay_doc,
+        "selfPlay(fen, white=None, black=None, nodes=1000, depth=" quote2(maxDepth) ", movetime=0.0,\n"
+        "         maxPlies=400, vector=None) -> result, moves\n"
+        "\n"
+        "Play a game between two engines that can differ in search parameters.\n"
+        "`white' and `black' are dicts with the parameters to change from the\n"
+        "current values. Each move is searched within the nodes, depth and\n"
+        "movetime limits. Both sides evaluate with `vector'. Games run without\n"
+        "the GIL, but threads can only play in parallel with their own vector.\n"
+        "The result is '1-0', '0-1' or '1/2-1/2' and the moves are in UCI notation\n"
+);
+
+// Current search parameters with the changes from a dict
+static int getSearchParams(PyObject *dict, int params[])
+{
+        memcpy(params, searchVector, searchVectorLen * sizeof params[0]);
+        if (dict == null || dict == Py_None)
+                return 0;
+        if (!PyDict_Check(dict)) {
+                PyErr_SetString(PyExc_TypeError, "Search parameters must be a dict");
+                return -1;
+        }
+        PyObject *key, *value;
+        Py_ssize_t pos = 0;
+        while (PyDict_Next(dict, &pos, &key, &value)) {
+                char *name = PyString_AsString(key);
+                if (!name)
+                        return -1;
+                int i = findSearchParameter(name);
+                if (i < 0)
+                        return -1;
+                long newValue = PyInt_AsLong(value);
+                if (newValue == -1 && PyErr_Occurred())
+                        return -1;
+                params[i] = newValue;
+        }
+        return 0;
+}
+
+static PyObject *
+floydmodule_selfPlay(PyObject *self, PyObject *args, PyObject *keywords)
+{
+        unused(self);
+        char *fen;
+        PyObject *white = null, *black = null;
+        long long nodes = 1000;
+        int depth = maxDepth;
+        double movetime = 0.0;
+        int maxPlies = 400;
+        VectorObject *vector = null;
+
+        static char *keywordList[] = { "fen", "white", "black", "nodes", "depth", "movetime",
+                "maxPlies", "vector", null };
+
+        if (!PyArg_ParseTupleAndKeywords(args, keywords, "s|OOLidiO!:selfPlay", keywordList,
+                &fen, &white, &black, &nodes, &depth, &movetime, &maxPlies, &VectorType, &vector))
                 return null;
 
-        if (PyTuple_SetItem(result, 0, PyFloat_FromDouble(engine.score / 1000.0))) {
-                Py_DECREF(result);
+        if (depth < 0 || depth > maxDepth)
+                return PyErr_Format(PyExc_ValueError, "Invalid depth (%d)", depth);
+
+        if (movetime < 0.0)
+                return PyErr_Format(PyExc_ValueError, "Invalid movetime (%g)", movetime);
+
+        if (nodes <= 0)
+                return PyErr_Format(PyExc_ValueError, "Invalid nodes (%lld)", nodes);
+
+        int params[2][searchVectorLen];
+        if (getSearchParams(white, params[0]) < 0 || getSearchParams(black, params[1]) < 0)
                 return null;
+
+        struct Engine engines[2];
+        Engine_t pair[2] = { &engines[0], &engines[1] };
+        for (int i=0; i<2; i++) {
+                initEngine(pair[i]);
+                ttSetSize(pair[i], 1024*1024);
+                pair[i]->searchParams = params[i];
+                pair[i]->target.depth = depth;
+                pair[i]->target.nodeCount = nodes;
+                pair[i]->target.scores = (intPair) {{ -maxInt, maxInt }};
+                pair[i]->target.time = 0.0;
+                pair[i]->target.maxTime = movetime;
+                pair[i]->infoFunction = noInfoFunction;
         }
 
-        PyObject *bestMove;
-        if (engine.bestMove != 0) {
-                char moveString[maxMoveSize];
-                moveToUci(moveString, engine.bestMove);
-                bestMove = PyString_FromString(moveString);
-        } else {
-                bestMove = Py_None;
-                Py_INCREF(Py_None);
+        if (setupBoard(&engines[0].board, fen) <= 0) {
+                for (int i=0; i<2; i++)
+                        cleanupEngine(pair[i]);
+                return PyErr_Format(PyExc_ValueError, "Invalid FEN (%s)", fen);
         }
 
-        if (PyTuple_SetItem(result, 1, bestMove)) {
-                Py_DECREF(bestMove);
-                Py_DECREF(result);
+        intList moves = emptyList;
+        int result;
+        Py_BEGIN_ALLOW_THREADS
+        Vector_t cVector = lockVector(vector);
+        engines[0].board.vector = engines[1].board.vector = cVector;
+        result = playGame(pair, fen, maxPlies, &moves);
+        unlockVector(vector);
+        Py_END_ALLOW_THREADS
+
+        bool interrupted = engines[0].interrupted || engines[1].interrupted;
+        for (int i=0; i<2; i++)
+                cleanupEngine(pair[i]);
+
+        if (interrupted) {
+                freeList(moves);
+                PyErr_SetNone(PyExc_KeyboardInterrupt);
                 return null;
         }
 
-        return result;
+        PyObject *moveList = PyList_New(moves.len);
+        for (int i=0; moveList && i<moves.len; i++) {
+                char moveString[maxMoveSize];
+                moveToUci(moveString, moves.v[i]);
+                PyObject *move = PyString_FromString(moveString);
+                if (!move) {
+                        Py_CLEAR(moveList);
+                        break;
+                }
+                PyList_SET_ITEM(moveList, i, move);
+        }
+        freeList(moves);
+        if (!moveList)
+                return null;
+
+        const char *resultString = (result > 0) ? "1-0" : (result < 0) ? "0-1" : "1/2-1/2";
+        return Py_BuildValue("(sN)", resultString, moveList);
 }
 
 /*----------------------------------------------------------------------+
@@ -238,9 +817,13 @@ floydmodule_search(PyObject *self, PyObject *args, PyObject *keywords)
  +----------------------------------------------------------------------*/
 
 static PyMethodDef floydMethods[] = {
-        { "evaluate",       floydmodule_evaluate,            METH_VARARGS,               evaluate_doc },
-        { "setCoefficient", floydmodule_setCoefficient,      METH_VARARGS,               setCoefficient_doc },
-        { "search",         (PyCFunction)floydmodule_search, METH_VARARGS|METH_KEYWORDS, search_doc },
+        { "evaluate",           (PyCFunction)floydmodule_evaluate, METH_VARARGS|METH_KEYWORDS, evaluate_doc },
+        { "setCoefficient",     floydmodule_setCoefficient,        METH_VARARGS,               setCoefficient_doc },
+        { "getSearchParameter", floydmodule_getSearchParameter,    METH_VARARGS,               getSearchParameter_doc },
+        { "setSearchParameter", floydmodule_setSearchParameter,    METH_VARARGS,               setSearchParameter_doc },
+        { "search",             (PyCFunction)floydmodule_search,   METH_VARARGS|METH_KEYWORDS, search_doc },
+        { "parseMove",          floydmodule_parseMove,             METH_VARARGS,               parseMove_doc },
+        { "selfPlay",           (PyCFunction)floydmodule_selfPlay, METH_VARARGS|METH_KEYWORDS, selfPlay_doc },
         { null, null, 0, null }
 };
 
@@ -256,6 +839,35 @@ initfloyd(void)
         if (!module)
                 return;
 
+        initPawnKingHash();
+        kpkGenerate(); // Now, before threads can race to do it lazily
+
+        defaultVectorLock = PyThread_allocate_lock();
+        if (!defaultVectorLock || PyType_Ready(&VectorType) < 0)
+                return;
+        PyObject *vectorType = (PyObject*) &VectorType;
+        Py_INCREF(vectorType);
+        PyModule_AddObject(module, "Vector", vectorType);
+
+        PyStructSequence_InitType(&SearchResultType, &searchResultDesc);
+        PyObject *searchResultType = (PyObject*) &SearchResultType;
+        Py_INCREF(searchResultType);
+        PyModule_AddObject(module, "SearchResult", searchResultType);
+
+        PyObject *labels = PyTuple_New(vectorLen);
+        if (labels) {
+                for (int coef=0; coef<vectorLen; coef++)
+                        PyTuple_SET_ITEM(labels, coef, PyString_FromString(vectorLabels[coef]));
+                PyModule_AddObject(module, "vectorLabels", labels);
+        }
+
+        labels = PyTuple_New(searchVectorLen);
+        if (labels) {
+                for (int i=0; i<searchVectorLen; i++)
+                        PyTuple_SET_ITEM(labels, i, PyString_FromString(searchLabels[i]));
+                PyModule_AddObject(module, "searchLabels", labels);
+        }
+
         PyObject *versionString = PyString_FromString(quote2(floydVersion));
         if (versionString)
                 PyModule_AddObject(module, "__version__", versionString);
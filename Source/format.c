@@ -21,6 +21,7 @@
 #include <ctype.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 // C extension
@@ -56,7 +57,10 @@ static const char pieceToChar[] = {
         [blackBishop] = 'b', [blackKnight] = 'n', [blackPawn] = 'p',
 };
 
-static const char promotionPieceToChar[] = { 'Q', 'R', 'B', 'N' };
+static const char promotionPieceToChar[] = {
+        [promoteBishopTag] = 'B', [promoteRookTag] = 'R',
+        [promoteKnightTag] = 'N', [promoteQueenTag] = 'Q',
+};
 
 /*----------------------------------------------------------------------+
  |      Functions                                                       |
@@ -78,9 +82,79 @@ extern char *moveToUci(char moveString[maxMoveSize], int move)
         *moveString++ = rankToChar(rank(from));
         *moveString++ = fileToChar(file(to));
         *moveString++ = rankToChar(rank(to));
-        if (((move & specialMoveFlag) && rank(from) == rank7 && rank(to) == rank8)
-         || ((move & specialMoveFlag) && rank(from) == rank2 && rank(to) == rank1))
-                *moveString++ = tolower(promotionPieceToChar[(move>>promotionBits)&3]);
+        if (isPromotion(move))
+                *moveString++ = tolower(promotionPieceToChar[moveTag(move)]);
+        *moveString = '\0';
+
+        return moveString;
+}
+
+/*----------------------------------------------------------------------+
+ |      Convert a move to SAN output                                    |
+ +----------------------------------------------------------------------*/
+
+/*
+ *  Convert into standard algebraic notation (SAN), for example Nbd7,
+ *  exd8=Q+ or O-O-O#. The move list is for disambiguation and must have
+ *  been prepared by the caller. The board is left unchanged.
+ */
+extern char *moveToSan(Board_t self, char moveString[maxMoveSize], int move, int xMoves[maxMoves], int xlen)
+{
+        int from = from(move);
+        int to   = to(move);
+        int piece = self->squares[from];
+        int pieceChar = toupper(pieceToChar[piece]);
+        int fileDistance = abs(file(to) - file(from));
+
+        if (pieceChar == 'K' && fileDistance == 2) { // Castling
+                moveString = stringCopy(moveString, (file(to) == fileG) ? "O-O" : "O-O-O");
+        } else if (pieceChar == 'P') {
+                if (fileDistance != 0) { // Capture
+                        *moveString++ = fileToChar(file(from));
+                        *moveString++ = 'x';
+                }
+                *moveString++ = fileToChar(file(to));
+                *moveString++ = rankToChar(rank(to));
+                if (isPromotion(move)) {
+                        *moveString++ = '=';
+                        *moveString++ = promotionPieceToChar[moveTag(move)];
+                }
+        } else {
+                *moveString++ = pieceChar;
+
+                // Other pieces of the same kind that can go there
+                bool ambiguous = false, sameFile = false, sameRank = false;
+                for (int i=0; i<xlen; i++) {
+                        int xFrom = from(xMoves[i]);
+                        if (to(xMoves[i]) == to && xFrom != from && self->squares[xFrom] == piece
+                         && isLegalMove(self, xMoves[i])) {
+                                ambiguous = true;
+                                sameFile |= file(xFrom) == file(from);
+                                sameRank |= rank(xFrom) == rank(from);
+                        }
+                }
+                if (ambiguous && (!sameFile || sameRank))
+                        *moveString++ = fileToChar(file(from));
+                if (ambiguous && sameFile)
+                        *moveString++ = rankToChar(rank(from));
+
+                if (self->squares[to] != empty)
+                        *moveString++ = 'x';
+                *moveString++ = fileToChar(file(to));
+                *moveString++ = rankToChar(rank(to));
+        }
+
+        // Check or mate
+        makeMove(self, move);
+        if (isInCheck(self)) {
+                int moveList[maxMoves];
+                int nrMoves = generateMoves(self, moveList, generateAll);
+                bool mate = true;
+                for (int i=0; i<nrMoves && mate; i++)
+                        mate = !isLegalMove(self, moveList[i]);
+                *moveString++ = mate ? '#' : '+';
+        }
+        undoMove(self);
         *moveString = '\0';
 
         return moveString;
@@ -0,0 +1,224 @@
+
+/*----------------------------------------------------------------------+
+ |                                                                      |
+ |      libfloyd.c -- Floyd as a C library                              |
+ |                                                                      |
+ +----------------------------------------------------------------------*/
+
+/*
+ *  Copyright (C) 2015-2016, Marcel van Kervinck
+ *  All rights reserved
+ *
+ *  Please read the enclosed file `LICENSE' or retrieve this document
+ *  from https://marcelk.net/floyd/LICENSE for terms and conditions.
+ */
+
+/*----------------------------------------------------------------------+
+ |      Includes                                                        |
+ +----------------------------------------------------------------------*/
+
+// C standard
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// System
+#include <pthread.h>
+
+// C extension
+#include "cplus.h"
+
+// Other modules
+#include "Board.h"
+#include "Engine.h"
+#include "kpk.h"
+
+// Own interface. The shared library exports only this (see Makefile)
+#pragma GCC visibility push(default)
+#include "libfloyd.h"
+#pragma GCC visibility pop
+
+/*----------------------------------------------------------------------+
+ |      Definitions                                                     |
+ +----------------------------------------------------------------------*/
+
+#define MiB (1ULL << 20)
+#define defaultHash (128 * MiB)
+
+struct floydEngine {
+        struct Engine engine;
+        Vector_t vector; // Own caches, so that engines don't share any state
+
+        floydInfo_fn *infoFunction;
+        void *infoData;
+        struct floydInfo info; // Of the last completed iteration
+};
+
+// Shared tables that would otherwise be set up lazily, by racing threads
+static pthread_once_t initOnce = PTHREAD_ONCE_INIT;
+
+/*----------------------------------------------------------------------+
+ |      Functions                                                       |
+ +----------------------------------------------------------------------*/
+
+static void initLibrary(void)
+{
+        initPawnKingHash();
+        kpkGenerate();
+        syncVector(null);
+}
+
+// Search info callback: translate to struct floydInfo
+static void libraryInfo(void *infoData)
+{
+        floydEngine_t self = infoData;
+        Engine_t engine = &self->engine;
+        struct floydInfo *info = &self->info;
+
+        info->depth = engine->depth;
+        info->score = engine->score;
+        info->mate = !isMateScore(engine->score) ? 0
+                   : (engine->score < 0) ? (minMate - engine->score    ) / 2
+                   :                       (maxMate - engine->score + 1) / 2;
+        info->nodes = engine->nodeCount;
+        info->seconds = engine->seconds;
+        info->pvLen = min(engine->pv.len, floydPvLen);
+        for (int i=0; i<info->pvLen; i++) {
+                char moveString[maxMoveSize];
+                moveToUci(moveString, engine->pv.v[i]);
+                stringCopy(info->pv[i], moveString);
+        }
+
+        if (self->infoFunction)
+                self->infoFunction(self->infoData, info);
+}
+
+/*----------------------------------------------------------------------+
+ |      floydNew / floydFree                                            |
+ +----------------------------------------------------------------------*/
+
+floydEngine_t floydNew(size_t hashBytes)
+{
+        pthread_once(&initOnce, initLibrary);
+
+        floydEngine_t self = calloc(1, sizeof(*self));
+        if (!self)
+                return null;
+        self->vector = newVector();
+        if (!self->vector) {
+                free(self);
+                return null;
+        }
+
+        initEngine(&self->engine);
+        ttSetSize(&self->engine, (hashBytes > 0) ? hashBytes : defaultHash);
+        setupBoard(&self->engine.board, startpos);
+        self->engine.board.vector = self->vector;
+        return self;
+}
+
+void floydFree(floydEngine_t self)
+{
+        if (!self)
+                return;
+        cleanupEngine(&self->engine);
+        freeVector(self->vector);
+        free(self);
+}
+
+/*----------------------------------------------------------------------+
+ |      floydSetPosition                                                |
+ +----------------------------------------------------------------------*/
+
+int floydSetPosition(floydEngine_t self, const char *fen, const char *moves)
+{
+        Board_t board = &self->engine.board;
+
+        if (setupBoard(board, fen ? fen : startpos) <= 0) {
+                setupBoard(board, startpos);
+                return -1;
+        }
+
+        const char *line = moves ? moves : "";
+        for (int n=1; n>0; line+=n) {
+                int moveList[maxMoves], move;
+                int nrMoves = generateMoves(board, moveList, generateAll);
+                n = parseUciMove(board, line, moveList, nrMoves, &move);
+                if (n > 0 && move > 0)
+                        makeMove(board, move);
+                else if (n > 0)
+                        break; // Illegal move
+        }
+        if (line[strspn(line, " \t\n")] != '\0') { // Illegal move or no move at all
+                setupBoard(board, startpos);
+                return -2;
+        }
+        return 0;
+}
+
+/*----------------------------------------------------------------------+
+ |      floydSearch / floydStop                                         |
+ +----------------------------------------------------------------------*/
+
+int floydSearch(floydEngine_t self, const struct floydLimits *limits,
+        floydInfo_fn *infoFunction, void *infoData,
+        char bestMove[floydMoveSize], struct floydInfo *lastInfo)
+{
+        Engine_t engine = &self->engine;
+        static const struct floydLimits noLimits;
+        if (!limits)
+                limits = &noLimits;
+
+        engine->target.depth = (limits->depth > 0) ? min(limits->depth, maxDepth) : maxDepth;
+        engine->target.nodeCount = (limits->nodes > 0) ? limits->nodes : maxLongLong;
+        engine->target.scores = (intPair) {{ -maxInt, maxInt }};
+        setTimeTargets(engine, limits->time, limits->inc, limits->movestogo, limits->movetime, 0.0);
+        engine->searchMoves.len = 0;
+        engine->pondering = false;
+
+        self->infoFunction = infoFunction;
+        self->infoData = infoData;
+        self->info = (struct floydInfo) { .depth = 0 };
+        engine->infoFunction = libraryInfo;
+        engine->infoData = self;
+
+        rootSearch(engine);
+
+        char moveString[maxMoveSize] = "";
+        if (engine->bestMove)
+                moveToUci(moveString, engine->bestMove);
+        stringCopy(bestMove, moveString);
+        if (lastInfo)
+                *lastInfo = self->info;
+        return engine->score;
+}
+
+void floydStop(floydEngine_t self)
+{
+        abortSearch(&self->engine);
+}
+
+/*----------------------------------------------------------------------+
+ |      floydEvaluate / floydPerft / floydLibraryVersion                |
+ +----------------------------------------------------------------------*/
+
+int floydEvaluate(floydEngine_t self)
+{
+        return evaluate(&self->engine.board);
+}
+
+long long floydPerft(floydEngine_t self, int depth)
+{
+        return moveTest(&self->engine.board, depth);
+}
+
+const char *floydLibraryVersion(void)
+{
+        return quote2(floydVersion);
+}
+
+/*----------------------------------------------------------------------+
+ |                                                                      |
+ +----------------------------------------------------------------------*/
+
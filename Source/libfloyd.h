@@ -0,0 +1,127 @@
+
+/*----------------------------------------------------------------------+
+ |                                                                      |
+ |      libfloyd.h -- Floyd as a C library                              |
+ |                                                                      |
+ +----------------------------------------------------------------------*/
+
+/*
+ *  Copyright (C) 2015-2016, Marcel van Kervinck
+ *  All rights reserved
+ *
+ *  Please read the enclosed file `LICENSE' or retrieve this document
+ *  from https://marcelk.net/floyd/LICENSE for terms and conditions.
+ */
+
+/*
+ *  The engine in-process, for programs that would otherwise run the UCI
+ *  binary and parse its output. Build with `make libfloyd' and link with
+ *  libfloyd.a or libfloyd.so (and -lm -lpthread for the static library).
+ *
+ *  Each handle is an engine with its own board, hash table and evaluation
+ *  caches. Different handles can be used from different threads at the
+ *  same time. One handle is for one thread at a time, except floydStop.
+ *
+ *  Scores are in millipawns from the side to move. Moves are in UCI
+ *  notation (e2e4, e7e8q, e1g1). This interface only changes together
+ *  with libfloydApiVersion.
+ */
+
+#ifndef libfloyd_h
+#define libfloyd_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------+
+ |      Definitions                                                     |
+ +----------------------------------------------------------------------*/
+
+#define libfloydApiVersion 1
+
+#define floydMoveSize 8  // Room for a UCI move and its terminating zero
+#define floydPvLen 64    // Longest principal variation reported
+
+typedef struct floydEngine *floydEngine_t;
+
+// Search limits. Zero means no limit for that item
+struct floydLimits {
+        int depth;          // Plies
+        long long nodes;
+        double movetime;    // Seconds
+        double time, inc;   // Clock and increment of the side to move, in seconds
+        int movestogo;
+};
+
+// Progress of the search, after each iteration
+struct floydInfo {
+        int depth;          // Completed iteration, in plies
+        int score;          // Millipawns
+        int mate;           // Moves to mate, negative when being mated, or 0
+        long long nodes;
+        double seconds;
+        int pvLen;
+        char pv[floydPvLen][floydMoveSize];
+};
+
+typedef void floydInfo_fn(void *data, const struct floydInfo *info);
+
+/*----------------------------------------------------------------------+
+ |      Functions                                                       |
+ +----------------------------------------------------------------------*/
+
+/*
+ *  New engine with a hash table of the given size in bytes (0 for the
+ *  128 MB default of the UCI engine), set to the starting position.
+ *  Null when out of memory.
+ */
+floydEngine_t floydNew(size_t hashBytes);
+
+void floydFree(floydEngine_t engine);
+
+/*
+ *  Set up a position from FEN (null for the starting position) followed
+ *  by space separated moves (null for none). Returns 0 when successful,
+ *  -1 for an invalid FEN and -2 for an illegal move. After an error the
+ *  engine is left in the starting position.
+ */
+int floydSetPosition(floydEngine_t engine, const char *fen, const char *moves);
+
+/*
+ *  Search the current position. `limits' and `infoFunction' can be null.
+ *  Writes the best move, or an empty string when there are no legal
+ *  moves, and returns the score. The final info is in `lastInfo' when
+ *  that is not null.
+ */
+int floydSearch(floydEngine_t engine, const struct floydLimits *limits,
+        floydInfo_fn *infoFunction, void *infoData,
+        char bestMove[floydMoveSize], struct floydInfo *lastInfo);
+
+/*
+ *  Stop a running search as soon as possible. This is the only function
+ *  that may be called from another thread while floydSearch is running.
+ */
+void floydStop(floydEngine_t engine);
+
+// Static evaluation of the current position
+int floydEvaluate(floydEngine_t engine);
+
+// Number of legal move sequences of the given length from the current position
+long long floydPerft(floydEngine_t engine, int depth);
+
+// Version string of the engine, as shown by the UCI binary
+const char *floydLibraryVersion(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*----------------------------------------------------------------------+
+ |                                                                      |
+ +----------------------------------------------------------------------*/
+
@@ -22,6 +22,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 // C extension
@@ -70,6 +71,14 @@ enum {
  |      Data                                                            |
  +----------------------------------------------------------------------*/
 
+/*
+ *  Promotion pieces by side and move tag
+ */
+static const int promotionPieces[][4] = {
+        { whiteBishop, whiteRook, whiteKnight, whiteQueen },
+        { blackBishop, blackRook, blackKnight, blackQueen }
+};
+
 /*
  *  Which castle bits to clear for a move's from and to
  */
@@ -187,39 +196,47 @@ static uint64_t hashEnPassant(int square);
  |      generateMoves                                                   |
  +----------------------------------------------------------------------*/
 
-// Helper to emit a regular move
-static void pushMove(Board_t self, int from, int to)
+// Helper to emit a move
+static void pushMove(Board_t self, int tag, int from, int to)
 {
-        *self->movePtr++ = move(from, to);
-}
-
-// Helper to emit a special move
-static void pushSpecialMove(Board_t self, int from, int to)
-{
-        *self->movePtr++ = specialMove(from, to);
+        *self->movePtr++ = taggedMove(tag, from, to);
 }
 
 // Helper to emit a pawn move
-static void pushPawnMove(Board_t self, int from, int to)
+static void pushPawnMove(Board_t self, int from, int to, int mode)
 {
         if (rank(to) == rank8 || rank(to) == rank1) {
-                pushSpecialMove(self, from, to);
-                self->movePtr[-1] += queenPromotionFlags;
-
-                pushSpecialMove(self, from, to);
-                self->movePtr[-1] += rookPromotionFlags;
-
-                pushSpecialMove(self, from, to);
-                self->movePtr[-1] += bishopPromotionFlags;
-
-                pushSpecialMove(self, from, to);
-                self->movePtr[-1] += knightPromotionFlags;
+                pushMove(self, promoteQueenTag, from, to);
+                if (mode == generateAll) {
+                        pushMove(self, promoteRookTag, from, to);
+                        pushMove(self, promoteBishopTag, from, to);
+                }
+                int knightMove = taggedMove(promoteKnightTag, from, to);
+                if (mode == generateAll || !isWeakUnderpromotion(self, knightMove))
+                        pushMove(self, promoteKnightTag, from, to);
         } else
-                pushMove(self, from, to); // normal pawn move
+                pushMove(self, movePawnTag, from, to); // normal pawn move
 }
 
 // Helper to generate slider moves
-static void generateSlides(Board_t self, int from, int dirs)
+#if mailboxSliders
+static void generateSlides(Board_t self, int tag, int from, int dirs)
+{
+        dirs &= kingDirections[from];
+        int dir = 0;
+        do {
+                dir = (dir - dirs) & dirs; // pick next
+                int vector = kingStep[dir];
+                int to = from;
+                int box = mailboxIndex(from), piece;
+                while ((piece = self->mailbox[box += x88s(vector)]) == empty)
+                        pushMove(self, tag, from, to += vector);
+                if (piece != mailboxBorder && pieceColor(piece) != sideToMove(self))
+                        pushMove(self, tag, from, to + vector);
+        } while (dirs -= dir); // remove and go to next
+}
+#else
+static void generateSlides(Board_t self, int tag, int from, int dirs)
 {
         dirs &= kingDirections[from];
         int dir = 0;
@@ -231,18 +248,19 @@ static void generateSlides(Board_t self, int from, int dirs)
                         to += vector;
                         if (self->squares[to] != empty) {
                                 if (pieceColor(self->squares[to]) != sideToMove(self))
-                                        pushMove(self, from, to);
+                                        pushMove(self, tag, from, to);
                                 break;
                         }
-                        pushMove(self, from, to);
+                        pushMove(self, tag, from, to);
                 } while (dir & kingDirections[to]);
         } while (dirs -= dir); // remove and go to next
 }
+#endif
 
 /*
  *  Pseudo-legal move generator
  */
-extern int generateMoves(Board_t self, int moveList[maxMoves])
+extern int generateMoves(Board_t self, int moveList[maxMoves], int mode)
 {
         int side = sideToMove(self);
         updateSideInfo(self);
@@ -270,20 +288,20 @@ extern int generateMoves(Board_t self, int moveList[maxMoves])
                                 if (self->squares[to] == empty
                                  || pieceColor(self->squares[to]) != sideToMove(self))
                                         if (self->sides[other(side)].attacks[to] == 0)
-                                                pushMove(self, from, to);
+                                                pushMove(self, moveKingTag, from, to);
                         } while (dirs -= dir); // remove and go to next
                         break;
 
                 case whiteQueen: case blackQueen:
-                        generateSlides(self, from, dirsQueen);
+                        generateSlides(self, moveQueenTag, from, dirsQueen);
                         break;
 
                 case whiteRook: case blackRook:
-                        generateSlides(self, from, dirsRook);
+                        generateSlides(self, moveKnightBishopRookTag, from, dirsRook);
                         break;
 
                 case whiteBishop: case blackBishop:
-                        generateSlides(self, from, dirsBishop);
+                        generateSlides(self, moveKnightBishopRookTag, from, dirsBishop);
                         break;
 
                 case whiteKnight: case blackKnight:
@@ -294,7 +312,7 @@ extern int generateMoves(Board_t self, int moveList[maxMoves])
                                 to = from + knightJump[dir];
                                 if (self->squares[to] == empty
                                  || pieceColor(self->squares[to]) != sideToMove(self))
-                                        pushMove(self, from, to);
+                                        pushMove(self, moveKnightBishopRookTag, from, to);
                         } while (dirs -= dir); // remove and go to next
                         break;
 
@@ -303,26 +321,23 @@ extern int generateMoves(Board_t self, int moveList[maxMoves])
                                 to = from + stepNE;
                                 if (self->squares[to] != empty
                                  && pieceColor(self->squares[to]) == black)
-                                        pushPawnMove(self, from, to);
+                                        pushPawnMove(self, from, to, mode);
                         }
                         if (file(from) != fileA) {
                                 to = from + stepNW;
                                 if (self->squares[to] != empty
                                  && pieceColor(self->squares[to]) == black)
-                                        pushPawnMove(self, from, to);
+                                        pushPawnMove(self, from, to, mode);
                         }
                         to = from + stepN;
                         if (self->squares[to] != empty)
                                 break;
 
-                        pushPawnMove(self, from, to);
+                        pushPawnMove(self, from, to, mode);
                         if (rank(from) == rank2) {
                                 to += stepN;
-                                if (self->squares[to] == empty) {
-                                        pushMove(self, from, to);
-                                        if (self->sides[black].attacks[to+stepS])
-                                                self->movePtr[-1] |= specialMoveFlag;
-                                }
+                                if (self->squares[to] == empty)
+                                        pushMove(self, movePawnTag, from, to);
                         }
                         break;
 
@@ -331,26 +346,23 @@ extern int generateMoves(Board_t self, int moveList[maxMoves])
                                 to = from + stepSE;
                                 if (self->squares[to] != empty
                                  && pieceColor(self->squares[to]) == white)
-                                        pushPawnMove(self, from, to);
+                                        pushPawnMove(self, from, to, mode);
                         }
                         if (file(from) != fileA) {
                                 to = from + stepSW;
                                 if (self->squares[to] != empty
                                  && pieceColor(self->squares[to]) == white)
-                                        pushPawnMove(self, from, to);
+                                        pushPawnMove(self, from, to, mode);
                         }
                         to = from + stepS;
                         if (self->squares[to] != empty)
                                 break;
 
-                        pushPawnMove(self, from, to);
+                        pushPawnMove(self, from, to, mode);
                         if (rank(from) == rank7) {
                                 to += stepS;
-                                if (self->squares[to] == empty) {
-                                        pushMove(self, from, to);
-                                        if (self->sides[white].attacks[to+stepN])
-                                                self->movePtr[-1] |= specialMoveFlag;
-                                }
+                                if (self->squares[to] == empty)
+                                        pushMove(self, movePawnTag, from, to);
                         }
                         break;
                 }
@@ -373,7 +385,7 @@ extern int generateMoves(Board_t self, int moveList[maxMoves])
                  && self->squares[sq+2*stepE] == empty
                  && self->sides[other(side)].attacks[sq+stepE] == 0
                  && self->sides[other(side)].attacks[sq+2*stepE] == 0)
-                        pushSpecialMove(self, sq, sq + 2*stepE);
+                        pushMove(self, moveKingTag, sq, sq + 2*stepE);
 
                 if ((self->castleFlags & flags[side][1])
                  && self->squares[sq+stepW] == empty
@@ -381,7 +393,7 @@ extern int generateMoves(Board_t self, int moveList[maxMoves])
                  && self->squares[sq+3*stepW] == empty
                  && self->sides[other(side)].attacks[sq+stepW] == 0
                  && self->sides[other(side)].attacks[sq+2*stepW] == 0)
-                        pushSpecialMove(self, sq, sq + 2*stepW);
+                        pushMove(self, moveKingTag, sq, sq + 2*stepW);
         }
 
         /*
@@ -396,15 +408,36 @@ extern int generateMoves(Board_t self, int moveList[maxMoves])
                 int ep = self->enPassantPawn;
 
                 if (file(ep) != fileA && self->squares[ep+stepW] == pawn)
-                        pushSpecialMove(self, ep + stepW, ep + step);
+                        pushMove(self, movePawnTag, ep + stepW, ep + step);
 
                 if (file(ep) != fileH && self->squares[ep+stepE] == pawn)
-                        pushSpecialMove(self, ep + stepE, ep + step);
+                        pushMove(self, movePawnTag, ep + stepE, ep + step);
         }
 
         return self->movePtr - moveList; // nrMoves
 }
 
+/*----------------------------------------------------------------------+
+ |      isWeakUnderpromotion                                            |
+ +----------------------------------------------------------------------*/
+
+extern bool isWeakUnderpromotion(Board_t self, int move)
+{
+        switch (moveTag(move)) {
+        case promoteRookTag:
+        case promoteBishopTag:
+                return true;
+        case promoteKnightTag: {
+                int xKing = self->sides[other(sideToMove(self))].king;
+                int fileDistance = abs(file(to(move)) - file(xKing));
+                int rankDistance = abs(rank(to(move)) - rank(xKing));
+                return fileDistance * rankDistance != 2; // No check
+        }
+        default:
+                return false;
+        }
+}
+
 /*----------------------------------------------------------------------+
  |      make/unmake move                                                |
  +----------------------------------------------------------------------*/
@@ -483,80 +516,66 @@ extern void makeMove(Board_t self, int move)
         }
 
         // Handle special moves first
-        if (move & specialMoveFlag) {
-                switch (rank(from)) {
-                case rank8:
-                        // Black castles. Insert the corresponding rook move
-                        if (to == g8)
-                                makeSimpleMove(h8, f8);
-                        else
-                                makeSimpleMove(a8, d8);
-                        break;
-
-                case rank7:
-                        if (self->squares[from] == blackPawn) { // Set en passant flag
-                                push(offsetof_enPassantPawn, 0);
+        int side = sideToMove(self);
+        int tag = moveTag(move);
+        switch (tag) {
+        case movePawnTag:
+                if (file(from) != file(to)) {
+                        if (self->squares[to] == empty) { // En passant capture
+                                int square = square(file(to), rank(from));
+                                int victim = self->squares[square];
+                                push(square, victim);
+                                self->squares[square] = empty;
+                                self->hash ^= zobristPiece[victim][square];
+                                self->pawnKingHash ^= zobristPiece[victim][square];
+                                self->materialKey -= materialKeys[victim][0];
+                        }
+                } else if (abs(to - from) == 2 * abs(stepN)) {
+                        int xPawn = (side == white) ? blackPawn : whitePawn;
+                        if ((file(to) != fileA && self->squares[to+stepW] == xPawn)
+                         || (file(to) != fileH && self->squares[to+stepE] == xPawn)) {
+                                push(offsetof_enPassantPawn, 0); // Set en passant flag
                                 self->enPassantPawn = to;
                                 self->hash ^= hashEnPassant(to);
-                        } else {
-                                push(from, self->squares[from]); // White promotes
-                                int promoPiece = whiteQueen + ((move >> promotionBits) & 3);
-                                self->squares[from] = promoPiece;
-                                self->hash ^= zobristPiece[whitePawn][from]
-                                            ^ zobristPiece[promoPiece][from];
-                                self->pawnKingHash ^= zobristPiece[whitePawn][from];
-                                self->materialKey += materialKeys[promoPiece][squareColor(to)]
-                                                   - materialKeys[whitePawn][0];
                         }
-                        break;
-
-                case rank5: // White captures en passant
-                case rank4: { // Black captures en passant
-                        int square = square(file(to), rank(from));
-                        int victim = self->squares[square];
-                        push(square, victim);
-                        self->squares[square] = empty;
-                        self->hash ^= zobristPiece[victim][square];
-                        self->pawnKingHash ^= zobristPiece[victim][square];
-                        self->materialKey -= materialKeys[victim][0];
-                        break;
                 }
-                case rank2:
-                        if (self->squares[from] == whitePawn) { // Set en passant flag
-                                push(offsetof_enPassantPawn, 0);
-                                self->enPassantPawn = to;
-                                self->hash ^= hashEnPassant(to);
-                        } else {
-                                push(from, self->squares[from]); // Black promotes
-                                int promoPiece = blackQueen + ((move >> promotionBits) & 3);
-                                self->squares[from] = promoPiece;
-                                self->hash ^= zobristPiece[blackPawn][from]
-                                            ^ zobristPiece[promoPiece][from];
-                                self->pawnKingHash ^= zobristPiece[blackPawn][from];
-                                self->materialKey += materialKeys[promoPiece][squareColor(to)]
-                                                   - materialKeys[blackPawn][0];
+                break;
+
+        case moveKingTag:
+                if (abs(to - from) == 2 * abs(stepE)) {
+                        // Castling. Insert the corresponding rook move
+                        switch (to) {
+                        case g1: makeSimpleMove(h1, f1); break;
+                        case c1: makeSimpleMove(a1, d1); break;
+                        case g8: makeSimpleMove(h8, f8); break;
+                        case c8: makeSimpleMove(a8, d8); break;
                         }
-                        break;
-
-                case rank1:
-                        // White castles. Insert the corresponding rook move
-                        if (to == g1)
-                                makeSimpleMove(h1, f1);
-                        else
-                                makeSimpleMove(a1, d1);
-                        break;
-
-                default:
-                        break;
                 }
+                break;
+
+        case promoteBishopTag:
+        case promoteRookTag:
+        case promoteKnightTag:
+        case promoteQueenTag: {
+                int pawn = self->squares[from];
+                int promoPiece = promotionPieces[side][tag - promoteBishopTag];
+                push(from, pawn);
+                self->squares[from] = promoPiece;
+                self->hash ^= zobristPiece[pawn][from]
+                            ^ zobristPiece[promoPiece][from];
+                self->pawnKingHash ^= zobristPiece[pawn][from];
+                self->materialKey += materialKeys[promoPiece][squareColor(to)]
+                                   - materialKeys[pawn][0];
+                break;
+        }
+        default:
+                break;
         }
 
         self->plyNumber++;
         self->hash ^= zobristTurn[0];
 
-        if (self->squares[to] != empty
-         || self->squares[from] == whitePawn
-         || self->squares[from] == blackPawn) {
+        if (self->squares[to] != empty || isPawnMove(move) || isPromotion(move)) {
                 push(offsetof_halfmoveClock, self->halfmoveClock); // This is why it is a byte
                 self->halfmoveClock = 0;
         } else
@@ -580,6 +599,70 @@ extern void makeMove(Board_t self, int move)
                 normalizeEnPassantStatus(self);
 }
 
+/*----------------------------------------------------------------------+
+ |      hashAfterMove                                                   |
+ +----------------------------------------------------------------------*/
+
+/*
+ *  The same as the hash after makeMove, except that after a double push
+ *  next to an enemy pawn the en passant square is always included, even
+ *  when the capture would be illegal. Such a key is then not in the table.
+ */
+extern uint64_t hashAfterMove(Board_t self, int move)
+{
+        int from = from(move), to = to(move);
+        int piece = self->squares[from], victim = self->squares[to];
+        int side = sideToMove(self);
+        uint64_t key = self->hash ^ zobristTurn[0] ^ hashEnPassant(self->enPassantPawn);
+
+        int tag = moveTag(move);
+        switch (tag) {
+        case movePawnTag:
+                if (file(from) != file(to)) {
+                        if (victim == empty) { // En passant capture
+                                int square = square(file(to), rank(from));
+                                key ^= zobristPiece[self->squares[square]][square];
+                        }
+                } else if (abs(to - from) == 2 * abs(stepN)) {
+                        int xPawn = (side == white) ? blackPawn : whitePawn;
+                        if ((file(to) != fileA && self->squares[to+stepW] == xPawn)
+                         || (file(to) != fileH && self->squares[to+stepE] == xPawn))
+                                key ^= hashEnPassant(to);
+                }
+                break;
+
+        case moveKingTag:
+                if (abs(to - from) == 2 * abs(stepE)) {
+                        // Castling. Include the rook move
+                        switch (to) {
+                        case g1: key ^= zobristPiece[whiteRook][h1] ^ zobristPiece[whiteRook][f1]; break;
+                        case c1: key ^= zobristPiece[whiteRook][a1] ^ zobristPiece[whiteRook][d1]; break;
+                        case g8: key ^= zobristPiece[blackRook][h8] ^ zobristPiece[blackRook][f8]; break;
+                        case c8: key ^= zobristPiece[blackRook][a8] ^ zobristPiece[blackRook][d8]; break;
+                        }
+                }
+                break;
+
+        case promoteBishopTag:
+        case promoteRookTag:
+        case promoteKnightTag:
+        case promoteQueenTag: {
+                int promoPiece = promotionPieces[side][tag - promoteBishopTag];
+                key ^= zobristPiece[piece][from] ^ zobristPiece[promoPiece][from];
+                piece = promoPiece;
+                break;
+        }
+        default:
+                break;
+        }
+
+        key ^= hashCastleFlags((castleFlagsClear[from] | castleFlagsClear[to]) & self->castleFlags);
+
+        return key ^ zobristPiece[piece][from]
+                   ^ zobristPiece[piece][to]
+                   ^ zobristPiece[victim][to];
+}
+
 /*----------------------------------------------------------------------+
  |      recaptureSquare                                                 |
  +----------------------------------------------------------------------*/
@@ -627,6 +710,35 @@ void makeNullMove(Board_t self)
  +----------------------------------------------------------------------*/
 
 // Helper to update slider attacks
+#if mailboxSliders
+static void updateSliderAttacks(Board_t self, int from, int dirs, struct side *side, int attackValue)
+{
+        dirs &= kingDirections[from];
+        int dir = 0;
+        do {
+                dir = (dir - dirs) & dirs; // pick next
+                int vector = kingStep[dir], boxVector = x88s(vector);
+                int to = from;
+                int box = mailboxIndex(from), piece;
+                do {
+                        to += vector;
+                        box += boxVector;
+                        piece = self->mailbox[box];
+                        if (piece == mailboxBorder) break;
+                        side->attacks[to] += attackValue;
+                } while (piece == empty);
+        } while (dirs -= dir); // remove and go to next
+}
+
+// Copy the board into the mailbox. The border is set by setupBoard
+static void updateMailbox(Board_t self)
+{
+        for (int file=0; file<8; file++) {
+                int square = square(file, rank1);
+                memcpy(&self->mailbox[mailboxIndex(square)], &self->squares[square], 8);
+        }
+}
+#else
 static void updateSliderAttacks(Board_t self, int from, int dirs, struct side *side, int attackValue)
 {
         dirs &= kingDirections[from];
@@ -641,6 +753,7 @@ static void updateSliderAttacks(Board_t self, int from, int dirs, struct side *s
                 } while (dir & kingDirections[to]);
         } while (dirs -= dir); // remove and go to next
 }
+#endif
 
 extern void updateSideInfo(Board_t self)
 {
@@ -648,6 +761,9 @@ extern void updateSideInfo(Board_t self)
                 return;
 
         memset(&self->sides, 0, sizeof self->sides);
+#if mailboxSliders
+        updateMailbox(self);
+#endif
 
         for (int from=0; from<boardSize; from++) {
                 int piece = self->squares[from];
@@ -782,21 +898,25 @@ uint64_t hash(Board_t self)
         return key;
 }
 
+// Hash constants for the pawn/king hash. Not lazily, because of threads
+void initPawnKingHash(void)
+{
+        for (int square=0; square<boardSize; square++) {
+                subHash[whitePawn][square] = zobristPiece[whitePawn][square];
+                subHash[blackPawn][square] = zobristPiece[blackPawn][square];
+                int kingFile = file(square);
+                kingFile = (kingFile == fileA) ? fileB : (kingFile == fileH) ? fileG : kingFile;
+                subHash[whiteKing][square] = zobristPiece[whiteKing][square(kingFile,rank1)];
+                subHash[blackKing][square] = zobristPiece[blackKing][square(kingFile,rank8)];
+                //subHash[whiteBishop][square] = zobristPiece[whiteBishop][squareColor(square) ? c1 : f1];
+                //subHash[blackBishop][square] = zobristPiece[blackBishop][squareColor(square) ? f8 : c8];
+        }
+}
+
 // Pawn/king hash
 uint64_t pawnKingHash(Board_t self)
 {
-        if (subHash[whitePawn][a1] == 0ULL) { // Implicit initialization
-                for (int square=0; square<boardSize; square++) {
-                        subHash[whitePawn][square] = zobristPiece[whitePawn][square];
-                        subHash[blackPawn][square] = zobristPiece[blackPawn][square];
-                        int kingFile = file(square);
-                        kingFile = (kingFile == fileA) ? fileB : (kingFile == fileH) ? fileG : kingFile;
-                        subHash[whiteKing][square] = zobristPiece[whiteKing][square(kingFile,rank1)];
-                        subHash[blackKing][square] = zobristPiece[blackKing][square(kingFile,rank8)];
-                        //subHash[whiteBishop][square] = zobristPiece[whiteBishop][squareColor(square) ? c1 : f1];
-                        //subHash[blackBishop][square] = zobristPiece[blackBishop][squareColor(square) ? f8 : c8];
-                }
-        }
+        assert(subHash[whitePawn][a1] != 0ULL); // initPawnKingHash was called
 
         uint64_t key = 0;
 
@@ -847,12 +967,12 @@ void normalizeEnPassantStatus(Board_t self)
         int step = (sideToMove(self) == white) ? stepN : stepS;
 
         if (file(square) != fileA && self->squares[square+stepW] == pawn) {
-                int move = specialMove(square + stepW, square + step);
+                int move = move(square + stepW, square + step);
                 if (isLegalMove(self, move))
                         return;
         }
         if (file(square) != fileH && self->squares[square+stepE] == pawn) {
-                int move = specialMove(square + stepE, square + step);
+                int move = move(square + stepE, square + step);
                 if (isLegalMove(self, move))
                         return;
         }
@@ -871,7 +991,7 @@ long long moveTest(Board_t self, int depth)
                 return 1;
         long long total = 0;
         int moveList[maxMoves];
-        int nrMoves = generateMoves(self, moveList);
+        int nrMoves = generateMoves(self, moveList, generateAll);
         for (int i=0; i<nrMoves; i++) {
                 makeMove(self, moveList[i]);
                 if (wasLegalMove(self))
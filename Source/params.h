@@ -0,0 +1,127 @@
+
+/*----------------------------------------------------------------------+
+ |                                                                      |
+ |      params.h                                                        |
+ |                                                                      |
+ +----------------------------------------------------------------------*/
+
+/*
+ *  This header is included three times from within search.c, each time
+ *  with a redefinition of macro P for a different use case:
+ *  1. to define enum identifiers for the search parameters
+ *  2. to generate a table with names so that these are available at runtime
+ *  3. to generate a vector with default values
+ *  And once from uci.c, to size the pending values of the UCI options.
+ *
+ *  Unlike the evaluation vector these are not tuned by Tools/tune.py,
+ *  but by self-play with Tools/spsa.py. They are also hidden UCI options
+ *  for experiments, for example:
+ *      setoption name nullStagedDepth value 6
+ *
+ *  Each engine reads them through its own searchParams pointer, so that
+ *  engines with different parameters can play each other in one process.
+ *
+ *  Depths and reductions are in plies, unless marked as in depth units.
+ *  A ply is onePly units (Engine.h), so that these can be fractional.
+ */
+
+// {
+        // Null move pruning
+        P(nullMinDepth, 2),       // Don't try null move at lower depth
+        P(nullMaxReduction, 3),   // R = (depth + 1) / 2, but not above this
+        P(nullVerifyDepth, 5),    // Verify fail highs at cut nodes from this depth
+
+        // Staged null move: a cheap search with large reduction first, and a
+        // confirmation with smaller reduction when it fails high by a small margin
+        P(nullStagedDepth, 0),    // Use staged null move from this depth (0 = off)
+        P(nullStage1Reduction, 4),
+        P(nullStage2Reduction, 2),
+        P(nullConfirmMargin, 500), // Fail highs by more than this don't need confirmation
+
+        // Futility pruning at frontier (depth 1) and pre-frontier (depth 2) nodes.
+        // The margin is a base plus a linear model on the futility features of
+        // evaluate(). The weights must be in the same order as enum futilityFeature.
+        // Use Tools/futility.py to fit these from search samples.
+        P(futilityBase_1, 2000),  // Depth 1, even distance from the PV
+        P(futilityBase_1X, 1500), // Depth 1, odd distance from the PV
+        P(futilityBase_2, 4000),  // Depth 2
+        P(futilityHanging_0, 0),
+        P(futilityHanging_1, 0),
+        P(futilityHanging_2, 0),
+        P(futilityHanging_0X, 0),
+        P(futilityHanging_1X, 0),
+        P(futilityHanging_2X, 0),
+        P(futilityPassers, 0),
+        P(futilityPassersX, 0),
+        P(futilityKingZone, 0),
+        P(futilityKingZoneX, 0),
+        P(razorMargin, 6000),     // Razoring at depth 3
+
+        // Late move reductions in scout nodes
+        P(lmrMinDepth, 4),        // Reduce from this depth
+        P(lmrMinMoves, 1),        // ... after this many moves
+        P(lmrReduction, 4),       // In depth units
+
+        // Extensions, in depth units. Not more than one ply each.
+        P(checkExtension, 4),     // Evasions in PV and scout nodes
+        P(recaptureExtension, 4), // Recaptures in PV nodes
+
+        // Internal iterative deepening at cut nodes without a hash move
+        P(iidMinDepth, 3),
+        P(iidReduction, 2),
+
+        // Enhanced transposition cutoffs: look up all children in the hash table
+        P(etcMinDepth, 2),        // From this depth, at cut nodes (0 = off)
+
+        // Delta pruning in quiescence search. The margin is looked up by material
+        // phase (0 = endgame .. 3 = opening) and SEE value of the capture. For
+        // SEE values beyond the table it is extrapolated with deltaSlope.
+        // Use Tools/delta.py to fit these from search samples.
+        P(deltaPhase0_0, 1450),
+        P(deltaPhase0_1, 2650),
+        P(deltaPhase0_2, 3850),
+        P(deltaPhase0_3, 5050),
+        P(deltaPhase0_4, 6250),
+        P(deltaPhase0_5, 7450),
+        P(deltaPhase0_6, 8650),
+        P(deltaPhase0_7, 9850),
+        P(deltaPhase0_8, 11050),
+        P(deltaPhase1_0, 1450),
+        P(deltaPhase1_1, 2650),
+        P(deltaPhase1_2, 3850),
+        P(deltaPhase1_3, 5050),
+        P(deltaPhase1_4, 6250),
+        P(deltaPhase1_5, 7450),
+        P(deltaPhase1_6, 8650),
+        P(deltaPhase1_7, 9850),
+        P(deltaPhase1_8, 11050),
+        P(deltaPhase2_0, 1450),
+        P(deltaPhase2_1, 2650),
+        P(deltaPhase2_2, 3850),
+        P(deltaPhase2_3, 5050),
+        P(deltaPhase2_4, 6250),
+        P(deltaPhase2_5, 7450),
+        P(deltaPhase2_6, 8650),
+        P(deltaPhase2_7, 9850),
+        P(deltaPhase2_8, 11050),
+        P(deltaPhase3_0, 1450),
+        P(deltaPhase3_1, 2650),
+        P(deltaPhase3_2, 3850),
+        P(deltaPhase3_3, 5050),
+        P(deltaPhase3_4, 6250),
+        P(deltaPhase3_5, 7450),
+        P(deltaPhase3_6, 8650),
+        P(deltaPhase3_7, 9850),
+        P(deltaPhase3_8, 11050),
+        P(deltaSlope, 1200),
+
+        // Reduction rescue: search a reduced move again at full depth when its
+        // subtree turned out much bigger than that of its siblings on average
+        P(rescueFactor, 8),
+        P(rescueMinSiblings, 2),
+// }
+
+/*----------------------------------------------------------------------+
+ |                                                                      |
+ +----------------------------------------------------------------------*/
+
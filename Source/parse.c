@@ -46,9 +46,19 @@
  |      Data                                                            |
  +----------------------------------------------------------------------*/
 
-static const int promotionFlags[] = {
-        ['q'] = queenPromotionFlags,  ['r'] = rookPromotionFlags,
-        ['b'] = bishopPromotionFlags, ['n'] = knightPromotionFlags,
+static const int promotionTags[] = {
+        ['q'] = promoteQueenTag,  ['r'] = promoteRookTag,
+        ['b'] = promoteBishopTag, ['n'] = promoteKnightTag,
+        ['Q'] = promoteQueenTag,  ['R'] = promoteRookTag,
+        ['B'] = promoteBishopTag, ['N'] = promoteKnightTag,
+};
+
+// Piece letters in SAN, the same for both sides
+static const char pieceLetters[] = {
+        [whiteKing]   = 'K', [whiteQueen]  = 'Q', [whiteRook] = 'R',
+        [whiteBishop] = 'B', [whiteKnight] = 'N', [whitePawn] = 'P',
+        [blackKing]   = 'K', [blackQueen]  = 'Q', [blackRook] = 'R',
+        [blackBishop] = 'B', [blackKnight] = 'N', [blackPawn] = 'P',
 };
 
 /*----------------------------------------------------------------------+
@@ -162,6 +172,9 @@ extern int setupBoard(Board_t self, const char *fen)
         while (isdigit(fen[ix])) ix++;
 
         self->sideInfoPlyNumber = -1; // side info is invalid now
+#if mailboxSliders
+        memset(self->mailbox, mailboxBorder, sizeof self->mailbox); // See updateSideInfo
+#endif
 
         // Reset the undo stack
         self->undoStack.len = 0;
@@ -172,6 +185,7 @@ extern int setupBoard(Board_t self, const char *fen)
 
         self->pawnKingHash = pawnKingHash(self);
         self->pkHashHistory.len = 0;
+        self->materialHistory.len = 0;
 
         normalizeEnPassantStatus(self); // Only safe after update of hash
 
@@ -211,6 +225,7 @@ extern int parseUciMove(Board_t self, const char *line, int xMoves[maxMoves], in
 {
         int ix = 0; // index into line
         int rawMove = 0;
+        int promotionTag = 0; // 0 when no promotion piece is given
 
         while (isspace(line[ix])) // Skip white space
                 ix++;
@@ -242,7 +257,7 @@ extern int parseUciMove(Board_t self, const char *line, int xMoves[maxMoves], in
 
                 if (line[ix] == 'q' || line[ix] == 'r'
                  || line[ix] == 'b' || line[ix] == 'n')
-                        rawMove += promotionFlags[(int)line[ix++]];
+                        promotionTag = promotionTags[(int)line[ix++]];
         }
 
         if (!isspace(line[ix]) && line[ix] != '\0')
@@ -251,12 +266,98 @@ extern int parseUciMove(Board_t self, const char *line, int xMoves[maxMoves], in
         // Find matching move from move list and verify its legality
         for (int i=0; i<xlen; i++) {
                 int xMove = xMoves[i];
-                if ((xMove & ~specialMoveFlag) == rawMove && isLegalMove(self, xMove))
+                int xTag = isPromotion(xMove) ? moveTag(xMove) : 0;
+                if (xTag == promoteQueenTag && promotionTag == 0)
+                        xTag = 0; // Promote to queen by default
+                if (move(from(xMove), to(xMove)) == rawMove && xTag == promotionTag
+                 && isLegalMove(self, xMove))
                         return (*move = xMove), ix;
         }
         return (*move = -1), ix;
 }
 
+/*
+ *  Parse a move in standard algebraic notation (SAN). Also accept
+ *  redundant disambiguation (Ng1f3), a missing or surplus capture mark,
+ *  `-' between squares, and annotations such as + # ! and ?.
+ *  Return values are as for parseUciMove. Ambiguous moves are illegal.
+ */
+extern int parseSanMove(Board_t self, const char *line, int xMoves[maxMoves], int xlen, int *move)
+{
+        int ix = 0; // index into line
+        int pieceLetter = 'P';
+        int fromFile = -1, fromRank = -1, toSquare;
+        int promotionTag = 0; // 0 when no promotion piece is given
+
+        while (isspace(line[ix])) // Skip white space
+                ix++;
+
+        int castleLen;
+        int nrOh = parseCastling(&line[ix], &castleLen);
+
+        if (nrOh == 2 || nrOh == 3) { // Castling
+                int rank = (sideToMove(self) == white) ? rank1 : rank8;
+                pieceLetter = 'K';
+                fromFile = fileE;
+                fromRank = rank;
+                toSquare = square((nrOh == 2) ? fileG : fileC, rank);
+                ix += castleLen;
+        } else {
+                if (line[ix] != '\0' && strchr("KQRBN", line[ix]))
+                        pieceLetter = line[ix++];
+
+                // Up to two squares, of which the first can be partial
+                char coords[4];
+                int n = 0;
+                for (;; ix++) {
+                        int c = line[ix];
+                        if (n < arrayLen(coords) && (inRange(c, 'a', 'h') || inRange(c, '1', '8')))
+                                coords[n++] = c;
+                        else if (c != 'x' && c != '-' && c != ':')
+                                break;
+                }
+                if (n < 2 || !inRange(coords[n-2], 'a', 'h') || !inRange(coords[n-1], '1', '8'))
+                        return 0;
+                toSquare = square(charToFile(coords[n-2]), charToRank(coords[n-1]));
+                for (int i=0; i<n-2; i++)
+                        if (inRange(coords[i], 'a', 'h'))
+                                fromFile = charToFile(coords[i]);
+                        else
+                                fromRank = charToRank(coords[i]);
+
+                if (line[ix] == '=' && line[ix+1] != '\0' && strchr("QRBNqrbn", line[ix+1]))
+                        promotionTag = promotionTags[(int)line[++ix]], ix++;
+                else if (line[ix] != '\0' && strchr("QRBN", line[ix]))
+                        promotionTag = promotionTags[(int)line[ix++]];
+        }
+
+        while (line[ix] != '\0' && strchr("+#!?", line[ix])) // Annotations
+                ix++;
+
+        if (!isspace(line[ix]) && line[ix] != '\0')
+                return 0; // Reject garbage following the move
+
+        // Find the only matching move from the move list
+        int found = -1;
+        for (int i=0; i<xlen; i++) {
+                int xMove = xMoves[i];
+                int xTag = isPromotion(xMove) ? moveTag(xMove) : 0;
+                if (xTag == promoteQueenTag && promotionTag == 0)
+                        xTag = 0; // Promote to queen by default
+                int xFrom = from(xMove);
+                if (to(xMove) == toSquare && xTag == promotionTag
+                 && pieceLetters[self->squares[xFrom]] == pieceLetter
+                 && (fromFile < 0 || file(xFrom) == fromFile)
+                 && (fromRank < 0 || rank(xFrom) == fromRank)
+                 && isLegalMove(self, xMove)) {
+                        if (found >= 0)
+                                return (*move = -1), ix; // Ambiguous
+                        found = xMove;
+                }
+        }
+        return (*move = found), ix;
+}
+
 /*----------------------------------------------------------------------+
  |                                                                      |
  +----------------------------------------------------------------------*/
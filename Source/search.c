@@ -20,8 +20,10 @@
 // Python API (must come first)
 #ifdef PYTHON_MODULE
  #include "Python.h"
+ // The search runs without the GIL, so only poll the SIGINT flag
+ #define interruptOccurred() PyOS_InterruptOccurred()
 #else
- #define PyErr_CheckSignals() 0 // Stub
+ #define interruptOccurred() 0 // Stub
 #endif
 
 // C standard
@@ -30,6 +32,7 @@
 #include <setjmp.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -46,8 +49,10 @@
 
 struct Node {
         struct ttSlot slot;
+        int secondMove;
         int phase; // Lazy move generation
         int nrMoves, i;
+        bool tactical; // Of the move made last
         int moveList[maxMoves];
 };
 
@@ -60,8 +65,34 @@ struct Node {
 //                                             moveMask (15 bits)
 #define moveMask ((int) ones(15))
 #define moveScore(longMove) ((longMove) >> 26) // Extract score from move list entry
+#define minMoveScore (-32)
 #define historyBits 11 // 15 for a move and 6 for SEE leaves 11 for history
-#define historyIndex(move) ((int) ((move) & ones(12)))
+#define historyIndex(side, move) /* side, piece tag and to-square */ \
+        ((int) (((side) << 9) | (((move) >> boardBits) & (ones(3) << boardBits)) | ((move) & ones(6))))
+
+enum searchParam {
+        #define P(id, value) id
+        #include "params.h"
+        #undef P
+};
+#define param(id) self->searchParams[id]
+
+/*----------------------------------------------------------------------+
+ |      Data                                                            |
+ +----------------------------------------------------------------------*/
+
+const char * const searchLabels[] = {
+        #define P(id, value) #id
+        #include "params.h"
+        #undef P
+};
+const int searchVectorLen = arrayLen(searchLabels);
+
+int searchVector[] = {
+        #define P(id, value) [id] = (value)
+        #include "params.h"
+        #undef P
+};
 
 /*----------------------------------------------------------------------+
  |      Functions                                                       |
@@ -78,6 +109,16 @@ static int filterLegalMoves(Board_t self, int moveList[], int nrMoves);
 static bool moveToFront(int moveList[], int nrMoves, int move);
 static bool repetition(Engine_t self);
 static bool allowNullMove(Board_t self);
+static int futilityMargin(Engine_t self, int depth, int pvDistance);
+static void writeFutilitySample(Engine_t self, int depth, int pvDistance, int eval, int alpha, int score,
+        const short features[nrFutilityFeatures]);
+static int deltaMargin(Engine_t self, int see, int phase);
+static void writeDeltaSample(Engine_t self, int see, int phase, int bestScore, int alpha, int score);
+static bool isDifficult(Engine_t self, long long nodeCount, long long sumNodeCount, int nrSiblings);
+static double rootMoveEffort(Engine_t self, int move);
+static void prepareRootMoves(Engine_t self);
+static void sortRootMoves(Engine_t self);
+static void updateRootMove(Engine_t self, int move, int score, long long nodeCount);
 
 static void killersToFront(Engine_t self, int ply, int moveList[], int nrMoves);
 static void updateKillers(Engine_t self, int ply, int move);
@@ -85,6 +126,8 @@ static void updateHistory(short historyCounts[], int index, int depth);
 
 static int makeFirstMove(Engine_t self, struct Node *node);
 static int makeNextMove(Engine_t self, struct Node *node);
+static int transpositionCutoff(Engine_t self, int depth, int alpha, int *score);
+static int extend(Engine_t self, bool inCheck, bool recapture);
 
 /*----------------------------------------------------------------------+
  |      rootSearch                                                      |
@@ -101,20 +144,24 @@ void rootSearch(Engine_t self)
 {
         double startTime = xTime();
         self->nodeCount = 0;
+        self->aborted = false;
+        self->stats = (struct searchStats) {0};
         self->rootPlyNumber = board(self)->plyNumber;
 
         assert(board(self)->hash == hash(board(self)));
         if (hash(board(self)) != self->lastSearched) {
                 self->lastSearched = hash(board(self));
-                self->pv.len = 0;
-                self->killers.len = 0;
+                newSearch(self);
                 self->bestMove = self->ponderMove = 0;
                 self->tt.now = (self->tt.now + 1) & ones(ttDateBits);
                 memset(self->historyCounts, 0, sizeof self->historyCounts);
         }
+        prepareRootMoves(self);
 
+        double alarmTime = xTime();
         if (self->target.maxTime > 0.0 && !self->pondering)
                 self->alarmHandle = setAlarm(self->target.maxTime, abortSearch, self);
+        self->alarmSeconds = xTime() - alarmTime;
 
         // Prepare abort possibility
         jmp_buf here;
@@ -124,12 +171,16 @@ void rootSearch(Engine_t self)
                 for (int iteration=0; iteration<=self->target.depth; iteration++) {
                         self->mateStop = true;
                         self->depth = iteration;
-                        self->score = pvSearch(self, iteration, -maxInt, maxInt, 0);
+                        sortRootMoves(self);
+                        self->score = pvSearch(self, iteration * onePly, -maxInt, maxInt, 0);
                         self->seconds = xTime() - startTime;
                         self->infoFunction(self->infoData);
                         updateBestAndPonderMove(self);
+                        // Stop sooner when the best move took most of the effort
+                        double effort = rootMoveEffort(self, self->bestMove); // 0 when unknown
+                        double timeFactor = min(0.5, 0.5 + 0.5 * (0.75 - effort));
                         bool moveReady = self->bestMove && (self->target.time > 0.0)
-                                      && (self->seconds >= 0.5 * self->target.time);
+                                      && (self->seconds >= timeFactor * self->target.time);
                         if (self->score <= self->target.scores.v[0]
                          || self->score >= self->target.scores.v[1]
                          || (isMateScore(self->score) && self->mateStop && self->depth > 0)
@@ -138,6 +189,7 @@ void rootSearch(Engine_t self)
                 }
         } else { // except abort
                 self->seconds = xTime() - startTime;
+                self->aborted = true;
                 while (ply(self) > 0)
                         undoMove(board(self));
                 int pvCut = updateBestAndPonderMove(self);
@@ -193,26 +245,33 @@ static int pvSearch(Engine_t self, int depth, int alpha, int beta, int pvIndex)
         int bestScore = minInt;
 
         // Quiescence search
-        if (depth == 0 && !inCheck) {
+        if (depth < onePly && !inCheck) {
                 bestScore = eval;
                 if (bestScore >= beta)
                         return cutPv(), ttWrite(self, slot, depth, bestScore, alpha, beta);
                 moveFilter = 0; // Only good captures
         }
 
-        // Generate moves, or use the `searchmoves' list when specified
+        // Generate moves, or take them from the root move list
         int moveList[maxMoves];
-        int nrMoves = generateMoves(board(self), moveList);
-        if (inRoot && self->searchMoves.len > 0) {
-                nrMoves = self->searchMoves.len;
-                memcpy(moveList, self->searchMoves.v, nrMoves * sizeof(int));
+        int nrMoves = 0;
+        if (inRoot) {
+                for (int i=0; i<self->rootMoves.len; i++)
+                        if (moveScore(self->rootMoves.v[i].move) >= moveFilter)
+                                moveList[nrMoves++] = self->rootMoves.v[i].move;
+        } else {
+                nrMoves = generateMoves(board(self), moveList, generateAll);
+                nrMoves = filterAndSort(self, moveList, nrMoves, moveFilter);
+                nrMoves = filterLegalMoves(board(self), moveList, nrMoves); // Easier for PVS
         }
-        nrMoves = filterAndSort(self, moveList, nrMoves, moveFilter);
-        nrMoves = filterLegalMoves(board(self), moveList, nrMoves); // Easier for PVS
+        moveToFront(moveList, nrMoves, ttReadSecondMove(self));
         moveToFront(moveList, nrMoves, slot.move);
+        int secondMove = 0;
+        long long sumNodeCount = 0; // Subtree sizes of the moves searched so far
 
         // Search the first move with open alpha-beta window
         if (nrMoves > 0) {
+                long long startCount = self->nodeCount;
                 if (pvIndex < self->pv.len)
                         moveToFront(moveList, nrMoves, self->pv.v[pvIndex]); // Follow the PV
                 else
@@ -220,39 +279,54 @@ static int pvSearch(Engine_t self, int depth, int alpha, int beta, int pvIndex)
                 int move = moveList[0];
                 bool recapture = moveScore(move) > 0 && to(move) == recaptureSquare(board(self));
                 makeMove(board(self), move);
-                int extension = (inCheck || recapture) + (nrMoves == 1 && (depth > 0));
-                int newDepth = max(0, depth - 1 + extension);
+                int extension = extend(self, inCheck, recapture) + (nrMoves == 1 && depth >= onePly) * onePly;
+                int newDepth = max(0, depth - onePly + extension);
                 int newAlpha = max(alpha, bestScore);
                 int score = -pvSearch(self, newDepth, -beta, -newAlpha, pvIndex + 1);
                 if (score > bestScore) {
                         bestScore = score;
+                        if (slot.move != (move & moveMask))
+                                secondMove = slot.move;
                         slot.move = move & moveMask;
                 } else
                         cutPv(); // Quiescence (standing pat)
                 undoMove(board(self));
+                long long nodeCount = self->nodeCount - startCount;
+                if (inRoot)
+                        updateRootMove(self, move, score, nodeCount);
+                sumNodeCount += nodeCount;
         } else
                 cutPv(); // Game end or leaf node (horizon)
 
         // Try the others with zero window and reductions, research if needed
-        int reduction = min(2, depth / 5);
+        int reduction = min(2, depth / (5 * onePly)) * onePly;
         for (int i=1; i<nrMoves && bestScore<beta; i++) {
                 int move = moveList[i];
                 bool recapture = moveScore(move) > 0 && to(move) == recaptureSquare(board(self));
                 makeMove(board(self), move);
-                int extension = (inCheck || recapture);
-                int newDepth = max(0, depth - 1 + extension - reduction);
+                int extension = extend(self, inCheck, recapture);
+                int newDepth = max(0, depth - onePly + extension - reduction);
+                int researchDepth = max(0, depth - onePly + extension);
                 int newAlpha = max(alpha, bestScore);
+                long long startCount = self->nodeCount;
                 int score = -scout(self, newDepth, -(newAlpha+1), 1, move);
+                if (score <= bestScore && newDepth < researchDepth
+                 && isDifficult(self, self->nodeCount - startCount, sumNodeCount, i)) {
+                        self->stats.rescues++;
+                        score = -scout(self, researchDepth, -(newAlpha+1), 1, move);
+                        self->stats.rescueCuts += (score > bestScore);
+                }
                 if (!isMateScore(score) && !isDrawScore(score))
                         self->mateStop = false; // Shortest mate not yet proven
                 if (score > bestScore) {
+                        self->stats.rootResearches += inRoot;
                         pushList(self->pv, 0); // Separator
                         int pvLen = self->pv.len;
                         pushList(self->pv, move);
-                        int researchDepth = max(0, depth - 1 + extension);
                         score = -pvSearch(self, researchDepth, -beta, -newAlpha, pvLen + 1);
                         if (score > bestScore) {
                                 bestScore = score;
+                                secondMove = slot.move;
                                 slot.move = move & moveMask;
                                 for (int j=0; pvLen+j<self->pv.len; j++)
                                         self->pv.v[pvIndex+j] = self->pv.v[pvLen+j];
@@ -261,11 +335,18 @@ static int pvSearch(Engine_t self, int depth, int alpha, int beta, int pvIndex)
                                 self->pv.len = pvLen - 1; // The research failed, it happens
                 }
                 undoMove(board(self));
+                long long nodeCount = self->nodeCount - startCount;
+                if (inRoot)
+                        updateRootMove(self, move, score, nodeCount);
+                sumNodeCount += nodeCount;
         }
 
         if (bestScore == minInt) // No legal moves
                 bestScore = gameOverScore(self, inCheck);
 
+        if (secondMove && depth >= onePly)
+                ttWriteSecondMove(self, secondMove);
+
         return ttWrite(self, slot, depth, bestScore, alpha, beta);
 }
 
@@ -277,9 +358,13 @@ static int scout(Engine_t self, int depth, int alpha, int pvDistance, int lastMo
 {
         self->nodeCount++;
         if (repetition(self)) return drawScore(self);
-        if (depth == 0) return qSearch(self, alpha); // TODO: we can put horizon stuff here
-        if (self->nodeCount >= self->target.nodeCount || PyErr_CheckSignals() == -1)
+        if (depth < onePly) return qSearch(self, alpha); // TODO: we can put horizon stuff here
+        if (self->nodeCount >= self->target.nodeCount)
                 longjmp(self->abortTarget, 1); // Raise abort
+        if (interruptOccurred()) {
+                self->interrupted = true;
+                longjmp(self->abortTarget, 1);
+        }
 
         // Mate distance pruning
         int mateBound = maxMate - ply(self) - 2;
@@ -293,43 +378,69 @@ static int scout(Engine_t self, int depth, int alpha, int pvDistance, int lastMo
                  || (node.slot.isLowerBound && node.slot.score > alpha))
                         return node.slot.score;
 
-        // Null move pruning or reduction (aka verification)
+        // Enhanced transposition cutoff
         int inCheck = isInCheck(board(self));
-        if (depth >= 2 && inRange(alpha, minEval, maxEval-1)
+        int extension = extend(self, inCheck, false);
+        if (param(etcMinDepth) > 0 && depth >= param(etcMinDepth) * onePly && isOdd(pvDistance)) {
+                int score, move = transpositionCutoff(self, depth - onePly + extension, alpha, &score);
+                if (move) {
+                        node.slot.move = move & moveMask;
+                        return ttWrite(self, node.slot, depth, score, alpha, alpha+1);
+                }
+        }
+
+        // Null move pruning or reduction (aka verification)
+        if (depth >= param(nullMinDepth) * onePly && inRange(alpha, minEval, maxEval-1)
          && lastMove != 0000 && !inCheck && allowNullMove(board(self))) {
                 makeNullMove(board(self));
-                int reduction = min((depth + 1) / 2, 3); // R = 1..3
-                int score = -scout(self,  depth - reduction - 1, -(alpha+1), pvDistance+1, 0000);
+                int reduction, score;
+                if (param(nullStagedDepth) > 0 && depth >= param(nullStagedDepth) * onePly) {
+                        reduction = param(nullStage1Reduction);
+                        score = -scout(self, max(0, depth - (reduction + 1) * onePly), -(alpha+1), pvDistance+1, 0000);
+                        if (score > alpha && score <= alpha + param(nullConfirmMargin)) { // Confirm
+                                self->stats.nullConfirms++;
+                                reduction = param(nullStage2Reduction);
+                                score = -scout(self, max(0, depth - (reduction + 1) * onePly), -(alpha+1), pvDistance+1, 0000);
+                        }
+                } else {
+                        reduction = min((depth + onePly) / (2 * onePly), param(nullMaxReduction)); // R = 1..3
+                        score = -scout(self, max(0, depth - (reduction + 1) * onePly), -(alpha+1), pvDistance+1, 0000);
+                }
                 undoMove(board(self));
-                if (score > alpha && depth >= 5 && isOdd(pvDistance)) // Verification
+                self->stats.nullMoves++;
+                self->stats.nullCuts += (score > alpha);
+                if (score > alpha && depth >= param(nullVerifyDepth) * onePly && isOdd(pvDistance)) // Verification
                         #define reduceIfEven(d) ((((d) + 1) & ~1) - 1) // Chop off the last reply
-                        return scout(self, reduceIfEven(depth - reduction), alpha, pvDistance, 0000);
+                        return scout(self, reduceIfEven(depth / onePly - reduction) * onePly, alpha, pvDistance, 0000);
                 if (score > alpha) // Pruning
                         return ttWrite(self, node.slot, depth, min(score, maxEval), alpha, alpha+1);
         }
 
-        // Futility pruning at frontier nodes
+        // Futility pruning at frontier nodes, and extended futility at pre-frontier nodes
         int bestScore = minInt;
         int moveFilter = minInt;
-        if (depth == 1 && inRange(alpha, minEval, maxEval-1) && !inCheck) {
-                int eval = evaluate(board(self));
-                if (eval - board(self)->futilityMargin > alpha) // Reverse futility (aka static null move)
+        int eval = 0, margin = 0;
+        bool futile = false, sampling = false;
+        short features[nrFutilityFeatures];
+        if (depth <= 2 * onePly && inRange(alpha, minEval, maxEval-1) && !inCheck) {
+                eval = evaluate(board(self));
+                if (depth < 2 * onePly && eval - board(self)->futilityMargin > alpha) // Reverse futility (aka static null move)
                         return ttWrite(self, node.slot, depth, alpha+1, alpha, alpha+1);
-                static const int margin[]  = { 2000, 1500 };
-                if (eval + margin[pvDistance&1] <= alpha) // Futility
-                        moveFilter = 0, bestScore = eval + margin[pvDistance&1];
+                margin = futilityMargin(self, depth, pvDistance);
+                futile = (eval + margin <= alpha);
+                self->stats.futilityTests++;
+                self->stats.futilityPrunes += futile;
+                if (self->sampleFile) { // Search all moves to see if the margin holds
+                        sampling = true;
+                        memcpy(features, board(self)->futilityFeatures, sizeof features);
+                } else if (futile)
+                        moveFilter = 0, bestScore = eval + margin;
         }
-        else if (depth == 2 && inRange(alpha, minEval, maxEval-1) && !inCheck) {
-                // Extended futility at pre-frontier nodes
-                int eval = evaluate(board(self));
-                if (eval + 4000 <= alpha)
-                        moveFilter = 0, bestScore = eval + 4000;
-        }
-        else if (depth == 3 && inRange(alpha, minEval, maxEval-1) && !inCheck) {
+        else if (depth <= 3 * onePly && inRange(alpha, minEval, maxEval-1) && !inCheck) {
                 // Razoring at pre-pre-frontier nodes
                 int eval = evaluate(board(self));
-                if (eval + 6000 <= alpha) {
-                        int score = scout(self, depth-2, alpha, pvDistance, 0000);
+                if (eval + param(razorMargin) <= alpha) {
+                        int score = scout(self, depth - 2 * onePly, alpha, pvDistance, 0000);
                         node.slot = ttRead(self);
                         if (score <= alpha)
                                 return ttWrite(self, node.slot, depth, score, alpha, alpha+1);
@@ -338,31 +449,43 @@ static int scout(Engine_t self, int depth, int alpha, int pvDistance, int lastMo
 
         // Internal iterative deepening
         #define isCutNode(pvDistance) isOdd(pvDistance)
-        if (depth >= 3 && isCutNode(pvDistance) && !node.slot.move) {
-                scout(self, depth - 2, alpha, pvDistance, lastMove);
+        if (depth >= param(iidMinDepth) * onePly && isCutNode(pvDistance) && !node.slot.move) {
+                scout(self, max(0, depth - max(1, param(iidReduction)) * onePly), alpha, pvDistance, lastMove);
                 node.slot = ttRead(self);
         }
 
         // Recursively search all moves until exhausted or one fails high
-        int extension = inCheck;
+        long long sumNodeCount = 0; // Subtree sizes of the moves searched so far
+        int nrSearched = 0;
         for (int move=makeFirstMove(self,&node), j=0; move; move=makeNextMove(self,&node), j++) {
                 if (move < moveFilter && !isInCheck(board(self))) {
                         undoMove(board(self)); // Move is futile and unlikely to fail high
                         continue;
                 }
-                int newDepth = max(0, depth - 1 + extension);
-                int reduction = (depth >= 4) && (j >= 1) && (move < 0);
-                int reducedDepth = max(0, newDepth - reduction);
+                int newDepth = max(0, depth - onePly + extension);
+                bool reduce = (depth >= param(lmrMinDepth) * onePly) && (j >= param(lmrMinMoves))
+                           && (move < 0) && !node.tactical;
+                int reducedDepth = reduce ? max(0, newDepth - param(lmrReduction)) : newDepth;
+                long long startCount = self->nodeCount;
                 int score = -scout(self, reducedDepth, -(alpha+1), pvDistance+1, move);
-                if (score > alpha && reducedDepth < newDepth)
-                        score = -scout(self, newDepth, -(alpha+1), pvDistance+1, move);
+                if (reducedDepth < newDepth) {
+                        bool rescue = (score <= alpha)
+                                   && isDifficult(self, self->nodeCount - startCount, sumNodeCount, nrSearched);
+                        if (score > alpha || rescue)
+                                score = -scout(self, newDepth, -(alpha+1), pvDistance+1, move);
+                        self->stats.rescues += rescue;
+                        self->stats.rescueCuts += rescue && (score > alpha);
+                }
                 undoMove(board(self));
+                sumNodeCount += self->nodeCount - startCount;
+                nrSearched++;
                 bestScore = max(bestScore, score);
                 if (score > alpha) { // Fail high
                         node.slot.move = move & moveMask;
                         if (j > 0) {
                                 updateKillers(self, ply(self), move);
-                                updateHistory(self->historyCounts, historyIndex(move), depth);
+                                int side = sideToMove(board(self));
+                                updateHistory(self->historyCounts, historyIndex(side, move), depth / onePly);
                         }
                         break;
                 }
@@ -371,6 +494,11 @@ static int scout(Engine_t self, int depth, int alpha, int pvDistance, int lastMo
         if (bestScore == minInt) // No legal moves
                 bestScore = gameOverScore(self, inCheck);
 
+        if (sampling) {
+                self->stats.futilityErrors += futile && (bestScore > alpha);
+                writeFutilitySample(self, depth, pvDistance, eval, alpha, bestScore, features);
+        }
+
         return ttWrite(self, node.slot, depth, bestScore, alpha, alpha+1);
 }
 
@@ -391,20 +519,25 @@ static int qSearch(Engine_t self, int alpha)
         int bestScore = inCheck ? minInt : evaluate(board(self));
         if (bestScore > alpha)
                 return ttWrite(self, slot, 0, bestScore, alpha, alpha+1);
+        int phase = board(self)->materialPhase; // Before the moves overwrite it
 
         // Generate good captures, or all escapes when in check
         int moveList[maxMoves];
-        int nrMoves = generateMoves(board(self), moveList);
+        int nrMoves = generateMoves(board(self), moveList, generateQueening);
         nrMoves = filterAndSort(self, moveList, nrMoves, inCheck ? minInt : 0);
         moveToFront(moveList, nrMoves, slot.move);
 
         // Try if any generated move can improve the result
         for (int i=0; i<nrMoves && bestScore<=alpha; i++) {
+                bool futile = false;
                 if (!inCheck) {
                         // Regular delta pruning
                         assert(moveList[i] >= 0);
-                        int maxDelta = (moveList[i] >> 26) * 1200 + 1450;
-                        if (maxDelta <= alpha - bestScore)
+                        int maxDelta = deltaMargin(self, moveScore(moveList[i]), phase);
+                        futile = (maxDelta <= alpha - bestScore);
+                        self->stats.deltaTests++;
+                        self->stats.deltaPrunes += futile;
+                        if (futile && !self->sampleFile) // When sampling, search to see if the margin holds
                                 return ttWrite(self, slot, 0, bestScore + maxDelta, alpha, alpha+1);
                 }
 
@@ -413,6 +546,10 @@ static int qSearch(Engine_t self, int alpha)
                 if (wasLegalMove(board(self))) {
                         self->nodeCount++;
                         int score = -qSearch(self, -(alpha+1));
+                        if (self->sampleFile && !inCheck) {
+                                self->stats.deltaErrors += futile && (score > alpha);
+                                writeDeltaSample(self, moveScore(moveList[i]), phase, bestScore, alpha, score);
+                        }
                         bestScore = max(bestScore, score);
                         if (score > alpha)
                                 slot.move = moveList[i] & moveMask;
@@ -454,8 +591,13 @@ static bool repetition(Engine_t self)
 static int makeFirstMove(Engine_t self, struct Node *node)
 {
         node->phase = 0;
-        int ttMove = node->moveList[0] = node->slot.move;
+        node->secondMove = ttReadSecondMove(self);
+        if (node->secondMove == node->slot.move)
+                node->secondMove = 0;
+
+        int ttMove = node->slot.move;
         if (ttMove) {
+                node->tactical = isTacticalMove(board(self), ttMove);
                 makeMove(board(self), ttMove);
                 if (wasLegalMove(board(self)))
                         return ttMove;
@@ -467,16 +609,28 @@ static int makeFirstMove(Engine_t self, struct Node *node)
 static int makeNextMove(Engine_t self, struct Node *node)
 {
         if (node->phase == 0) {
-                int ttMove = node->moveList[0];
-                node->nrMoves = generateMoves(board(self), node->moveList);
+                node->phase = 1;
+                int secondMove = node->secondMove;
+                if (secondMove) {
+                        node->tactical = isTacticalMove(board(self), secondMove);
+                        makeMove(board(self), secondMove);
+                        if (wasLegalMove(board(self)))
+                                return secondMove;
+                        undoMove(board(self));
+                }
+        }
+        if (node->phase == 1) {
+                node->nrMoves = generateMoves(board(self), node->moveList, generateAll);
                 node->nrMoves = filterAndSort(self, node->moveList, node->nrMoves, minInt);
                 killersToFront(self, ply(self), node->moveList, node->nrMoves);
-                node->i = moveToFront(node->moveList, node->nrMoves, ttMove); // skip if already emitted
-                node->phase = 1;
+                node->i = moveToFront(node->moveList, node->nrMoves, node->secondMove); // skip if already emitted
+                node->i += moveToFront(node->moveList, node->nrMoves, node->slot.move);
+                node->phase = 2;
         }
-        if (node->phase == 1)
+        if (node->phase == 2)
                 while (node->i < node->nrMoves) {
                         int move = node->moveList[node->i++];
+                        node->tactical = isTacticalMove(board(self), move);
                         makeMove(board(self), move);
                         if (wasLegalMove(board(self)))
                                 return move;
@@ -485,6 +639,53 @@ static int makeNextMove(Engine_t self, struct Node *node)
         return 0;
 }
 
+/*----------------------------------------------------------------------+
+ |      transpositionCutoff                                             |
+ +----------------------------------------------------------------------*/
+
+/*
+ *  Enhanced transposition cutoff (ETC): find a move to a position of which
+ *  the hash table already knows that it refutes alpha. All buckets are
+ *  prefetched before the first lookup, and then also stay in the cache
+ *  for the search of the moves when there is no cutoff.
+ */
+static int transpositionCutoff(Engine_t self, int depth, int alpha, int *score)
+{
+        Board_t board = board(self);
+        int moveList[maxMoves];
+        uint64_t hashes[maxMoves];
+        int nrMoves = generateMoves(board, moveList, generateAll);
+        for (int i=0; i<nrMoves; i++) {
+                hashes[i] = hashAfterMove(board, moveList[i]);
+                ttPrefetch(self, hashes[i]);
+        }
+
+        self->stats.etcTests++;
+        for (int i=0; i<nrMoves; i++) {
+                struct ttSlot slot = ttReadHash(self, hashes[i], board->plyNumber + 1);
+                if ((slot.depth >= depth || slot.isHardBound)
+                 && slot.isUpperBound && -slot.score > alpha
+                 && isLegalMove(board, moveList[i])) { // Don't trust a collision
+                        self->stats.etcCuts++;
+                        *score = -slot.score;
+                        return moveList[i];
+                }
+        }
+        return 0;
+}
+
+/*----------------------------------------------------------------------+
+ |      extend                                                          |
+ +----------------------------------------------------------------------*/
+
+// Extension in depth units, the largest that applies and at most one ply
+static int extend(Engine_t self, bool inCheck, bool recapture)
+{
+        int extension = max(inCheck   ? param(checkExtension)     : 0,
+                            recapture ? param(recaptureExtension) : 0);
+        return min(extension, onePly);
+}
+
 /*----------------------------------------------------------------------+
  |      staticMoveScore                                                 |
  +----------------------------------------------------------------------*/
@@ -514,11 +715,15 @@ static int staticMoveScore(Board_t self, int move)
         static const int pieceAttack[] = {
                 [27] = attackKing, [9] = attackQueen, [5] = attackRook, [3] = attackMinor
         };
-        static const int promotionValue[] = { 9, 5, 3, 3 };
+        static const int promotionValue[] = {
+                [promoteBishopTag] = 3, [promoteRookTag] = 5,
+                [promoteKnightTag] = 3, [promoteQueenTag] = 9,
+        };
 
         int to = to(move);
         int victim = self->squares[to]; // may be empty
-        int score = pieceValue[victim];
+        bool pawnCapture = isPawnCapture(move);
+        int score = (pawnCapture && victim == empty) ? 1 : pieceValue[victim]; // en passant
 
         int from = from(move);
         int piece = self->squares[from];
@@ -526,16 +731,16 @@ static int staticMoveScore(Board_t self, int move)
 
         int side = sideToMove(self);
         int attackers = self->sides[side].attacks[to] - pieceAttack[next];
-        if (next == 1 && score >= 0) attackers -= attackPawn; // TODO: en passant?
+        if (pawnCapture) attackers -= attackPawn;
 
-        bool lastRank = (rank(to) == rank1 || rank(to) == rank8);
-        if (next == 1 && lastRank) { // pawn promotion
-                next = promotionValue[(move>>promotionBits)&3];
+        bool promotion = isPromotion(move);
+        if (promotion) {
+                next = promotionValue[moveTag(move)];
                 score += next - 1;
         }
 
         int defenders = self->sides[other(side)].attacks[to];
-        if (defenders) score -= see(next, defenders, attackers, lastRank ? 8 : 0);
+        if (defenders) score -= see(next, defenders, attackers, promotion ? 8 : 0);
         return score;
 }
 
@@ -553,12 +758,15 @@ static int compareMoves(const void *ap, const void *bp)
 
 static int filterAndSort(Engine_t self, int moveList[], int nrMoves, int moveFilter)
 {
+        int side = sideToMove(board(self));
         int j = 0;
         for (int i=0; i<nrMoves; i++) {
                 int moveScore = staticMoveScore(board(self), moveList[i]);
+                if (isPromotion(moveList[i]) && isWeakUnderpromotion(board(self), moveList[i]))
+                        moveScore = minMoveScore; // Defer to the very end
                 if (moveScore >= moveFilter)
                         moveList[j++] = (moveScore << 26)
-                                      + (self->historyCounts[historyIndex(moveList[i])] << 15)
+                                      + (self->historyCounts[historyIndex(side, moveList[i])] << 15)
                                       + (moveList[i] & moveMask);
         }
         qsort(moveList, j, sizeof(moveList[0]), compareMoves);
@@ -621,7 +829,7 @@ static void updateHistory(short historyCounts[], int index, int depth)
 {
         historyCounts[index] += min(64, depth * depth); // Rookie v1
         if (historyCounts[index] >= (1 << historyBits))
-                for (int i=0; i <= historyIndex(~0); i++)
+                for (int i=0; i <= historyIndex(1, ~0); i++)
                         historyCounts[i] >>= 1;
 }
 
@@ -666,6 +874,121 @@ static bool allowNullMove(Board_t self)
         return bits == 7;
 }
 
+/*----------------------------------------------------------------------+
+ |      futilityMargin                                                  |
+ +----------------------------------------------------------------------*/
+
+// Margin model: base per depth and node type plus weighted evaluation features
+static int futilityMargin(Engine_t self, int depth, int pvDistance)
+{
+        int margin = (depth >= 2 * onePly) ? param(futilityBase_2)
+                   : isOdd(pvDistance)  ? param(futilityBase_1X)
+                   : /* even distance */  param(futilityBase_1);
+        for (int i=0; i<nrFutilityFeatures; i++)
+                margin += param(futilityHanging_0 + i) * board(self)->futilityFeatures[i];
+        return margin;
+}
+
+// Record for fitting the model off-line with Tools/futility.py
+static void writeFutilitySample(Engine_t self, int depth, int pvDistance, int eval, int alpha, int score,
+        const short features[nrFutilityFeatures])
+{
+        FILE *fp = self->sampleFile;
+        fprintf(fp, "futility %d %d %d %d %d", depth / onePly, pvDistance & 1, eval, alpha, score);
+        for (int i=0; i<nrFutilityFeatures; i++)
+                fprintf(fp, " %d", features[i]);
+        fputc('\n', fp);
+}
+
+/*----------------------------------------------------------------------+
+ |      deltaMargin                                                     |
+ +----------------------------------------------------------------------*/
+
+// Margin table by material phase and SEE value, extrapolated for big gains
+static int deltaMargin(Engine_t self, int see, int phase)
+{
+        int bucket = min(see, 8);
+        return param(deltaPhase0_0 + 9 * phase + bucket) + (see - bucket) * param(deltaSlope);
+}
+
+// Record for fitting the table off-line with Tools/delta.py
+static void writeDeltaSample(Engine_t self, int see, int phase, int bestScore, int alpha, int score)
+{
+        fprintf(self->sampleFile, "delta %d %d %d %d %d\n", see, phase, bestScore, alpha, score);
+}
+
+/*----------------------------------------------------------------------+
+ |      isDifficult / rootMoveEffort                                    |
+ +----------------------------------------------------------------------*/
+
+// Subtree is more than `rescueFactor' times the average of its older siblings
+static bool isDifficult(Engine_t self, long long nodeCount, long long sumNodeCount, int nrSiblings)
+{
+        return nrSiblings >= param(rescueMinSiblings)
+            && nodeCount * nrSiblings > param(rescueFactor) * sumNodeCount;
+}
+
+// Fraction of the last iteration's nodes spent on this root move
+static double rootMoveEffort(Engine_t self, int move)
+{
+        long long nodeCount = 0, sumNodeCount = 0;
+        for (int i=0; i<self->rootMoves.len; i++) {
+                if ((self->rootMoves.v[i].move & moveMask) == (move & moveMask))
+                        nodeCount = self->rootMoves.v[i].nodeCount;
+                sumNodeCount += self->rootMoves.v[i].nodeCount;
+        }
+        return (sumNodeCount > 0) ? (double) nodeCount / sumNodeCount : 0.0;
+}
+
+/*----------------------------------------------------------------------+
+ |      Root moves                                                      |
+ +----------------------------------------------------------------------*/
+
+// Legal root moves, or the `searchmoves' subset, in static order
+static void prepareRootMoves(Engine_t self)
+{
+        int moveList[maxMoves];
+        int nrMoves = generateMoves(board(self), moveList, generateAll);
+        nrMoves = filterAndSort(self, moveList, nrMoves, minInt);
+        nrMoves = filterLegalMoves(board(self), moveList, nrMoves);
+
+        self->rootMoves.len = 0;
+        for (int i=0; i<nrMoves; i++) {
+                bool selected = (self->searchMoves.len == 0);
+                for (int j=0; j<self->searchMoves.len && !selected; j++)
+                        selected = (self->searchMoves.v[j] & moveMask) == (moveList[i] & moveMask);
+                if (selected)
+                        pushList(self->rootMoves, ((struct rootMove) { moveList[i], minInt, 0 }));
+        }
+}
+
+// Comparator for qsort: descending order of score, then subtree size, then
+// the prescored move. qsort isn't stable, so ties must never be left to it
+static int compareRootMoves(const void *ap, const void *bp)
+{
+        const struct rootMove *a = ap, *b = bp;
+        if (a->score != b->score)
+                return (a->score < b->score) - (a->score > b->score);
+        if (a->nodeCount != b->nodeCount)
+                return (a->nodeCount < b->nodeCount) - (a->nodeCount > b->nodeCount);
+        return (a->move < b->move) - (a->move > b->move);
+}
+
+// Order by the results of the previous iteration (the PV move still goes first)
+static void sortRootMoves(Engine_t self)
+{
+        qsort(self->rootMoves.v, self->rootMoves.len, sizeof(self->rootMoves.v[0]), compareRootMoves);
+}
+
+static void updateRootMove(Engine_t self, int move, int score, long long nodeCount)
+{
+        for (int i=0; i<self->rootMoves.len; i++)
+                if ((self->rootMoves.v[i].move & moveMask) == (move & moveMask)) {
+                        self->rootMoves.v[i].score = score;
+                        self->rootMoves.v[i].nodeCount = nodeCount;
+                }
+}
+
 /*----------------------------------------------------------------------+
  |      updateBestAndPonderMove                                         |
  +----------------------------------------------------------------------*/
@@ -688,14 +1011,18 @@ static int updateBestAndPonderMove(Engine_t self)
  |      setTimeTargets                                                  |
  +----------------------------------------------------------------------*/
 
-static double target(double time, double inc, int movestogo)
+/*
+ *  The overhead is the time lost on each move outside the search: in the
+ *  engine before and after it, and in the GUI and the pipes in between.
+ */
+static double target(double time, double inc, int movestogo, double overhead)
 {
         double safety = (inc < 0.05) ? 20.0 : 2.5;
-        double target = (time + (movestogo - 1) * inc - safety) / movestogo;
+        double target = (time + (movestogo - 1) * inc - safety) / movestogo - overhead;
         return max(target, 0.05);
 }
 
-void setTimeTargets(Engine_t self, double time, double inc, int movestogo, double movetime)
+void setTimeTargets(Engine_t self, double time, double inc, int movestogo, double movetime, double overhead)
 {
         if (time > 0.0 || inc > 0.0) {
                 if (!movestogo) // Default time allocation horizon
@@ -707,14 +1034,14 @@ void setTimeTargets(Engine_t self, double time, double inc, int movestogo, doubl
                 case 45: movestogo = min(movestogo, 2); break;
                 }
                 int mintogo = max(1, movestogo / 5); // Upto 5 times the target
-                self->target.time = target(time, inc, movestogo);
-                double panicTime = target(time, inc, mintogo);
-                double flagTime = target(time, inc, 1);
+                self->target.time = target(time, inc, movestogo, overhead);
+                double panicTime = target(time, inc, mintogo, overhead);
+                double flagTime = target(time, inc, 1, overhead);
                 self->target.maxTime  = min(panicTime, flagTime);
         } else
                 self->target.time = self->target.maxTime = 0.0;
         if (movetime > 0.0)
-                self->target.maxTime = movetime;
+                self->target.maxTime = max(movetime - overhead, 0.5 * movetime);
 }
 
 /*----------------------------------------------------------------------+
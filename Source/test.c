@@ -18,6 +18,8 @@
  +----------------------------------------------------------------------*/
 
 // C standard
+#include <errno.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -100,6 +102,7 @@ void uciBenchmark(Engine_t self, double time, int bestOf)
 
         #define N arrayLen(positions)
         double best[N] = {0.0}, sum = 0.0;
+        long long allocCount = xAllocCount;
 
         for (int j=0, i=0; j<bestOf*N; j++, i=j%N) {
                 setupBoard(board(self), positions[i]);
@@ -118,30 +121,178 @@ void uciBenchmark(Engine_t self, double time, int bestOf)
         }
 
         printf("result nps %.0f\n", sum / N);
+        printf("result allocations %lld\n", xAllocCount - allocCount); // Should be 0
 
         setupBoard(board(self), oldPosition);
 }
 
 /*----------------------------------------------------------------------+
- |      uciMoves                                                        |
+ |      uciScaling                                                      |
  +----------------------------------------------------------------------*/
 
-void uciMoves(Board_t self, int depth)
+// Mean and half width of its 95% confidence interval (Student's t)
+static void confidence95(const double x[], int n, double *mean, double *halfWidth)
+{
+        static const double t975[] = {
+                0.0,  12.71, 4.30, 3.18, 2.78, 2.57, 2.45, 2.36, 2.31, 2.26,
+                2.23, 2.20,  2.18, 2.16, 2.14, 2.13, 2.12, 2.11, 2.10, 2.09,
+                2.09, 2.08,  2.07, 2.07, 2.06, 2.06, 2.06, 2.05, 2.05, 2.05,
+        };
+        double sum = 0.0, sumSquares = 0.0;
+        for (int i=0; i<n; i++)
+                sum += x[i];
+        *mean = sum / n;
+        for (int i=0; i<n; i++)
+                sumSquares += (x[i] - *mean) * (x[i] - *mean);
+        int df = n - 1;
+        double t = (df < arrayLen(t975)) ? t975[df] : 1.96;
+        *halfWidth = (n > 1) ? t * sqrt(sumSquares / df / n) : 0.0;
+}
+
+// Engines for the workers of a pool, each with its own evaluation caches
+static struct Engine *newWorkerEngines(Engine_t self, int n, size_t hashSize)
+{
+        struct Engine *engines = calloc(n, sizeof(engines[0]));
+        if (!engines) xAbort(errno, "calloc");
+        for (int i=0; i<n; i++) {
+                initEngine(&engines[i]);
+                engines[i].tt.policy = self->tt.policy;
+                engines[i].searchParams = self->searchParams;
+                ttSetSize(&engines[i], hashSize);
+                engines[i].board.vector = newVector();
+                if (!engines[i].board.vector) xAbort(errno, "newVector");
+        }
+        return engines;
+}
+
+static void freeWorkerEngines(struct Engine *engines, int n)
+{
+        for (int i=0; i<n; i++) {
+                freeVector(engines[i].board.vector);
+                cleanupEngine(&engines[i]);
+        }
+        free(engines);
+}
+
+struct scalingTask {
+        struct Engine *engines; // One per worker
+        int depth;
+        long long nodeCounts[arrayLen(positions)];
+};
+
+static void searchPositions(void *data, int worker, long begin, long end)
 {
+        struct scalingTask *task = data;
+        Engine_t self = &task->engines[worker];
+        for (long i=begin; i<end; i++) {
+                setupBoard(board(self), positions[i]);
+                ttClearFast(self);
+                self->target.time = 0.0;
+                self->target.maxTime = 0.0;
+                self->target.depth = task->depth;
+                self->target.nodeCount = maxLongLong;
+                self->target.scores = (intPair) {{ -maxInt, maxInt }};
+                self->infoFunction = noInfoFunction;
+                rootSearch(self);
+                task->nodeCounts[i] = self->nodeCount;
+        }
+}
+
+/*
+ *  Time and nodes to reach a fixed depth over the benchmark positions, for
+ *  hash sizes from minHash to maxHash (in MiB, stepping by 4x). Each run
+ *  starts every position with a cleared hash table. Output is CSV.
+ *
+ *  With nrThreads above 1, the positions are searched side by side, each
+ *  thread with its own hash table of the given size. The time is then the
+ *  wall time for all positions, so this measures the throughput and the
+ *  effect of shared memory bandwidth and caches. Node counts don't change.
+ */
+void uciScaling(Engine_t self, int depth, int repeat, long minHash, long maxHash, int nrThreads)
+{
+        kpkGenerate(); // Initialize before measuring speed
+
+        repeat = max(1, repeat);
+        double seconds[repeat], nodes[repeat];
+        printf("threads,hash,depth,runs,seconds,secondsCI,nodes,nodesCI\n");
+
+        xPool_t pool = createPool(max(1, nrThreads));
+        for (long hash=max(1, minHash); hash<=maxHash; hash*=4) {
+                struct scalingTask task = { .depth = depth };
+                task.engines = newWorkerEngines(self, poolSize(pool), hash << 20);
+                for (int j=0; j<repeat; j++) {
+                        double startTime = xTime();
+                        parallelFor(pool, 0, arrayLen(positions), 1, searchPositions, &task);
+                        seconds[j] = xTime() - startTime;
+                        nodes[j] = 0.0;
+                        for (int i=0; i<arrayLen(positions); i++)
+                                nodes[j] += task.nodeCounts[i];
+                }
+                freeWorkerEngines(task.engines, poolSize(pool));
+
+                double secondsMean, secondsCI, nodesMean, nodesCI;
+                confidence95(seconds, repeat, &secondsMean, &secondsCI);
+                confidence95(nodes, repeat, &nodesMean, &nodesCI);
+                printf("%d,%ld,%d,%d,%.3f,%.3f,%.0f,%.0f\n",
+                        poolSize(pool), hash, depth, repeat, secondsMean, secondsCI, nodesMean, nodesCI);
+                fflush(stdout);
+        }
+        destroyPool(pool);
+}
+
+/*----------------------------------------------------------------------+
+ |      uciMoves                                                        |
+ +----------------------------------------------------------------------*/
+
+struct movesTask {
+        char fen[maxFenSize];   // Of the root
+        struct Engine *engines; // One per worker, for its board
+        int depth;
         int moveList[maxMoves];
-        int nrMoves = generateMoves(self, moveList);
-        qsort(moveList, nrMoves, sizeof(moveList[0]), compareInt);
+        long long counts[maxMoves]; // -1 for illegal moves
+};
+
+static void countMoves(void *data, int worker, long begin, long end)
+{
+        struct movesTask *task = data;
+        Board_t board = board(&task->engines[worker]);
+        setupBoard(board, task->fen);
+        for (long i=begin; i<end; i++) {
+                makeMove(board, task->moveList[i]);
+                task->counts[i] = wasLegalMove(board) ? moveTest(board, task->depth - 1) : -1;
+                undoMove(board);
+        }
+}
+
+// Move generation test, with the root moves divided over the threads
+void uciMoves(Board_t self, int depth, int nrThreads)
+{
+        struct movesTask task = { .depth = depth };
+        boardToFen(self, task.fen);
+        int nrMoves = generateMoves(self, task.moveList, generateAll);
+        qsort(task.moveList, nrMoves, sizeof(task.moveList[0]), compareInt);
+
+        xPool_t pool = createPool(nrThreads);
+        task.engines = calloc(poolSize(pool), sizeof(task.engines[0]));
+        if (!task.engines) xAbort(errno, "calloc");
+        for (int i=0; i<poolSize(pool); i++)
+                initEngine(&task.engines[i]);
+
+        parallelFor(pool, 0, nrMoves, 1, countMoves, &task);
+
+        for (int i=0; i<poolSize(pool); i++)
+                cleanupEngine(&task.engines[i]);
+        free(task.engines);
+        destroyPool(pool);
+
         long long totalCount = 0;
         for (int i=0; i<nrMoves; i++) {
+                if (task.counts[i] < 0)
+                        continue;
                 char moveString[maxMoveSize];
-                moveToUci(moveString, moveList[i]);
-                makeMove(self, moveList[i]);
-                if (wasLegalMove(self)) {
-                        long long count = moveTest(self, depth - 1);
-                        printf("move %s count %lld\n", moveString, count);
-                        totalCount += count;
-                }
-                undoMove(self);
+                moveToUci(moveString, task.moveList[i]);
+                printf("move %s count %lld\n", moveString, task.counts[i]);
+                totalCount += task.counts[i];
         }
         printf("result count %lld\n", totalCount);
 }
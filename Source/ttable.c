@@ -41,11 +41,19 @@
 
 #define bucketLen 4 // must be power of 2
 
+// Two-tier policy: the first slots of a bucket keep the deepest results,
+// where each search since an entry was written counts as this many plies less
+#define depthPreferredLen 2
+#define ttAgePenalty 2
+
 /*----------------------------------------------------------------------+
  |      Functions                                                       |
  +----------------------------------------------------------------------*/
 
 static inline int prio(Engine_t self, int ix);
+static inline int agedDepth(Engine_t self, int ix);
+static int findAgeSlot(Engine_t self, size_t bucket);
+static int findTwoTierSlot(Engine_t self, size_t bucket, int depth);
 
 /*----------------------------------------------------------------------+
  |      ttSetSize                                                       |
@@ -153,23 +161,25 @@ int ttWrite(Engine_t self, struct ttSlot slot, int depth, int score, int alpha,
 
         /*
          *  Find best slot `bucket+i' to store the search result in, either
-         *   - the slot with the lowest (-age, depth)-priority, or
-         *   - the last used slot, if still present.
+         *   - the last used slot, if still present, or
+         *   - the slot chosen by the replacement policy.
          */
 
         size_t bucket = slot.key & self->tt.mask;
-        int i = -1, iPrio = maxInt;
+        int i = -1;
         for (int j=0; j<bucketLen; j++) {
                 struct ttSlot local = self->tt.slots[bucket+j];
                 if ((local.key ^ local.data) == slot.key) {
                         i = j;
                         break;
                 }
-                int jPrio = prio(self, bucket + j);
-                if (jPrio < iPrio)
-                        i = j, iPrio = jPrio;
         }
-        assert(i >= 0);
+        if (i < 0) {
+                i = (self->tt.policy == ttTwoTierPolicy)
+                  ? findTwoTierSlot(self, bucket, depth)
+                  : findAgeSlot(self, bucket);
+        }
+        self->stats.ttStores++;
 
         /*
          *  Write into table
@@ -181,21 +191,75 @@ int ttWrite(Engine_t self, struct ttSlot slot, int depth, int score, int alpha,
         return score;
 }
 
+/*----------------------------------------------------------------------+
+ |      findAgeSlot / findTwoTierSlot                                   |
+ +----------------------------------------------------------------------*/
+
+// Slot with the lowest (-age, depth)-priority
+static int findAgeSlot(Engine_t self, size_t bucket)
+{
+        int i = 0, iPrio = prio(self, bucket);
+        for (int j=1; j<bucketLen; j++) {
+                int jPrio = prio(self, bucket + j);
+                if (jPrio < iPrio)
+                        i = j, iPrio = jPrio;
+        }
+        self->stats.ttEvictions += (self->tt.slots[bucket+i].date == self->tt.now);
+        return i;
+}
+
+/*
+ *  The shallowest depth-preferred slot, when the new result is at least as
+ *  deep after aging. Its old entry then moves down to the always-replace
+ *  slots. Otherwise the shallowest always-replace slot.
+ */
+static int findTwoTierSlot(Engine_t self, size_t bucket, int depth)
+{
+        int i = 0, iDepth = agedDepth(self, bucket);
+        for (int j=1; j<depthPreferredLen; j++) {
+                int jDepth = agedDepth(self, bucket + j);
+                if (jDepth < iDepth)
+                        i = j, iDepth = jDepth;
+        }
+
+        int k = depthPreferredLen, kDepth = agedDepth(self, bucket + k);
+        for (int j=k+1; j<bucketLen; j++) {
+                int jDepth = agedDepth(self, bucket + j);
+                if (jDepth < kDepth)
+                        k = j, kDepth = jDepth;
+        }
+
+        self->stats.ttEvictions += (self->tt.slots[bucket+k].date == self->tt.now);
+        if (depth < iDepth)
+                return k;
+
+        self->tt.slots[bucket+k] = self->tt.slots[bucket+i]; // Demote
+        return i;
+}
+
 /*----------------------------------------------------------------------+
  |      ttRead                                                          |
  +----------------------------------------------------------------------*/
 
 struct ttSlot ttRead(Engine_t self)
 {
-        uint64_t hash = board(self)->hash ^ self->tt.baseHash;
+        return ttReadHash(self, board(self)->hash, board(self)->plyNumber);
+}
+
+// For a position that is not on the board, such as after a move
+struct ttSlot ttReadHash(Engine_t self, uint64_t boardHash, int plyNumber)
+{
+        uint64_t hash = boardHash ^ self->tt.baseHash;
         size_t bucket = hash & self->tt.mask;
 
+        self->stats.ttProbes++;
         for (int i=0; i<bucketLen; i++) {
                 struct ttSlot local = self->tt.slots[bucket+i];
                 local.key ^= local.data;
                 if (local.key == hash) { // Found
+                        self->stats.ttHits++;
                         if (local.isWinLossScore) {
-                                int rootDistance = board(self)->plyNumber - self->rootPlyNumber;
+                                int rootDistance = plyNumber - self->rootPlyNumber;
                                 local.score += local.score >= 0 ? -rootDistance : rootDistance;
                         }
                         return local;
@@ -205,6 +269,40 @@ struct ttSlot ttRead(Engine_t self)
         return (struct ttSlot) { .key = hash, .data = 0 };
 }
 
+/*----------------------------------------------------------------------+
+ |      ttPrefetch                                                      |
+ +----------------------------------------------------------------------*/
+
+// Start loading the bucket of a position into the cache, for a read soon after
+void ttPrefetch(Engine_t self, uint64_t boardHash)
+{
+        size_t bucket = (boardHash ^ self->tt.baseHash) & self->tt.mask;
+        __builtin_prefetch(&self->tt.slots[bucket]);
+}
+
+/*----------------------------------------------------------------------+
+ |      ttReadSecondMove / ttWriteSecondMove                            |
+ +----------------------------------------------------------------------*/
+
+/*
+ *  PV nodes remember the previous best move when it gets replaced, so that
+ *  a research can try it right after the hash move. Direct mapped, always replace.
+ */
+int ttReadSecondMove(Engine_t self)
+{
+        uint64_t hash = board(self)->hash ^ self->tt.baseHash;
+        size_t ix = hash & (secondMovesLen - 1);
+        return (self->tt.secondMoves[ix].key == hash) ? self->tt.secondMoves[ix].move : 0;
+}
+
+void ttWriteSecondMove(Engine_t self, int move)
+{
+        uint64_t hash = board(self)->hash ^ self->tt.baseHash;
+        size_t ix = hash & (secondMovesLen - 1);
+        self->tt.secondMoves[ix].key = hash;
+        self->tt.secondMoves[ix].move = move;
+}
+
 /*----------------------------------------------------------------------+
  |      ttCalcLoad                                                      |
  +----------------------------------------------------------------------*/
@@ -245,6 +343,14 @@ static inline int prio(Engine_t self, int ix)
         return (-age << ttDepthBits) + slot->depth;
 }
 
+// Depth for the two-tier policy, less for each search since it was written
+static inline int agedDepth(Engine_t self, int ix)
+{
+        struct ttSlot *slot = &self->tt.slots[ix];
+        int age = (self->tt.now - slot->date) & ones(ttDateBits);
+        return slot->depth - ttAgePenalty * onePly * age;
+}
+
 /*----------------------------------------------------------------------+
  |                                                                      |
  +----------------------------------------------------------------------*/
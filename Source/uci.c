@@ -40,19 +40,65 @@
  |      Definitions                                                     |
  +----------------------------------------------------------------------*/
 
+// One element per search parameter, to size the array in struct options
+static const char searchParamSlots[] = {
+        #define P(id, value) 0
+        #include "params.h"
+        #undef P
+};
+
 struct options {
         long Hash;
         bool ClearHash;
+        int HashPolicy;
+        char RecordFile[256];
+        long MoveOverhead;
+        int searchParams[sizeof searchParamSlots]; // Hidden options, see params.h
 };
 #define maxHash ((sizeof(size_t) > 4) ? 64 * 1024L : 1024L)
 
 #define ms (1e-3)
+#define us (1e-6)
 #define MiB (1ULL << 20)
 
+// Latency phases between `go' and `bestmove'
+enum latencyPhase {
+        parsePhase,     // Parsing the command and setting the time targets
+        threadPhase,    // Creating the search thread
+        alarmPhase,     // Setting the alarm, if any, also after `ponderhit'
+        searchPhase,    // The search itself, from `ponderhit' when pondering, not for `infinite'
+        outputPhase,    // Writing and flushing `bestmove'
+        overheadPhase,  // All of the above except the search
+        totalPhase,     // From `go', or from `ponderhit' when pondering
+        nrLatencyPhases
+};
+
+#define nrLatencyBuckets 32 // Powers of 2 microseconds, upto more than an hour
+
 /*----------------------------------------------------------------------+
  |      Data                                                            |
  +----------------------------------------------------------------------*/
 
+// Session recording, see uciRecord
+static FILE *recordFile;
+static double recordStartTime;
+static xLock_t recordLock; // For the above, also taken by the search thread
+
+static const char * const latencyNames[nrLatencyPhases] = {
+        "parse", "thread", "alarm", "search", "output", "overhead", "total"
+};
+
+// Latency histograms, see uciLatency
+static struct {
+        double goTime, parsedTime; // Of the last `go', for the search thread
+        double ponderhitTime;      // Of its `ponderhit', or 0
+        double ponderhitAlarm;     // Time taken by setAlarm after `ponderhit'
+        long long count[nrLatencyPhases];
+        double sum[nrLatencyPhases];
+        double max[nrLatencyPhases];
+        long long buckets[nrLatencyPhases][nrLatencyBuckets];
+} latency;
+
 static const char helpMessage[] =
  #define X "\n"
  "This engine uses the Universal Chess Interface (UCI) protocol."
@@ -67,7 +113,8 @@ X"        Set option. The new value becomes active with the next `isready'."
 X"  isready"
 X"        Activate any changed options and reply `readyok' when done."
 X"  ucinewgame"
-X"        A new game has started. (ignored)"
+X"        A new game has started. Stop any search, clear the hash table"
+X"        and setup the starting position."
 X"  position [ startpos | fen <fenField> ... ] [ moves <move> ... ]"
 X"        Setup the position on the internal board and play out the sequence"
 X"        of moves. In debug mode also show the resulting FEN and board."
@@ -103,10 +150,29 @@ X"  eval"
 X"        Show evaluation."
 X"  bench [ movetime <millis> ] [ bestof <repeat> ]"
 X"        Speed test using 40 standard positions. Default: movetime 333 bestof 3"
-X"  moves [ depth <ply> ]"
-X"        Move generation test. Default: depth 1"
+X"  scaling [ depth <ply> ] [ repeat <count> ] [ minhash <mb> ] [ maxhash <mb> ] [ threads <n> ]"
+X"        Time and nodes to depth over the bench positions for hash sizes from"
+X"        minhash to maxhash in steps of 4x, with 95% confidence intervals, as CSV."
+X"        More threads search different positions at the same time, each with"
+X"        its own hash table. Default: depth 6 repeat 3 minhash 1 maxhash 64 threads 1"
+X"  moves [ depth <ply> ] [ threads <n> ]"
+X"        Move generation test. Default: depth 1, one thread per core"
+X"  stats"
+X"        Stop any search and show statistics of the last one, including"
+X"        the nodes spent on each root move in the last iteration."
+X"  latency"
+X"        Stop any search and show histograms of the time from `go' until"
+X"        `bestmove', split into phases. Also shown on `quit'."
 X
 X"Unknown commands and options are silently ignored, except in debug mode."
+X
+X"Extra options:"
+X"  Record File"
+X"        Write all input lines, search output and time targets of this session,"
+X"        with timestamps, to this file. Use Tools/replay.py to play it back."
+X"  Move Overhead"
+X"        Time in milliseconds to keep in reserve for each move, on top of the"
+X"        99th percentile of the overhead that the engine measures itself."
 X;
 
 /*----------------------------------------------------------------------+
@@ -116,6 +182,13 @@ X;
 static xThread_t stopSearch(Engine_t self, xThread_t searchThread);
 static xThread_t startSearch(Engine_t self);
 static void uciBestMove(Engine_t self);
+static void uciStats(Engine_t self);
+static void uciLatency(void);
+static void addLatency(int phase, double seconds);
+static double latencyPercentile(int phase, double fraction);
+static int scanSearchParameter(char **line, int searchParams[]);
+static void uciRecord(char kind, const char *format, ...);
+static void startRecording(const struct options *options);
 
 static void updateOptions(Engine_t self,
         struct options *options, const struct options *newOptions);
@@ -160,20 +233,28 @@ void uciMain(Engine_t self)
         bool debug = false;
         struct options oldOptions = { .Hash = -1 };
         struct options newOptions = { .Hash = 128 };
+        assert(arrayLen(newOptions.searchParams) == searchVectorLen);
+        memcpy(oldOptions.searchParams, searchVector, sizeof oldOptions.searchParams);
+        memcpy(newOptions.searchParams, searchVector, sizeof newOptions.searchParams);
 
         // Prepare threading
         xThread_t searchThread = null;
+        recordLock = createLock();
 
         // Process commands
         while (readLine(stdin, &lineBuffer) != 0) {
                 char *line = lineBuffer.v;
                 if (debug) printf("info string input %s", line);
+                uciRecord('>', "%s", line);
 
                 if (scan("uci"))
                         printf("id name Floyd "quote2(floydVersion)"\n"
                                "id author Marcel van Kervinck\n"
                                "option name Hash type spin default %ld min 0 max %ld\n"
                                "option name Clear Hash type button\n"
+                               "option name Hash Policy type combo default age var age var twotier\n"
+                               "option name Record File type string default <empty>\n"
+                               "option name Move Overhead type spin default 0 min 0 max 5000\n"
                                "option name Ponder type check default true\n"
                                "uciok\n",
                                 newOptions.Hash, maxHash);
@@ -188,13 +269,29 @@ void uciMain(Engine_t self)
                         else if (scan("name Ponder value true")) pass;
                         else if (scan("name Ponder value false")) pass; // just ignore it
                         else if (scan("name Clear Hash")) newOptions.ClearHash = !oldOptions.ClearHash;
+                        else if (scan("name Hash Policy value age")) newOptions.HashPolicy = ttAgePolicy;
+                        else if (scan("name Hash Policy value twotier")) newOptions.HashPolicy = ttTwoTierPolicy;
+                        else if (scan("name Record File value <empty>")) newOptions.RecordFile[0] = '\0';
+                        else if (scanValue("name Record File value %255[^\n]", newOptions.RecordFile)) {
+                                // The path is the rest of the line and may contain spaces
+                                int len = strlen(newOptions.RecordFile);
+                                while (len > 0 && isspace(newOptions.RecordFile[len-1]))
+                                        newOptions.RecordFile[--len] = '\0';
+                        }
+                        else if (scan("name Record File")) newOptions.RecordFile[0] = '\0';
+                        else if (scanValue("name Move Overhead value %ld", &newOptions.MoveOverhead)) pass;
+                        else scanSearchParameter(&line, newOptions.searchParams);
                 }
                 else if (scan("isready")) {
                         updateOptions(self, &oldOptions, &newOptions);
                         printf("readyok\n");
+                        uciRecord('<', "readyok");
+                }
+                else if (scan("ucinewgame")) {
+                        searchThread = stopSearch(self, searchThread);
+                        newGame(self);
+                        setupBoard(board(self), startpos);
                 }
-                else if (scan("ucinewgame"))
-                        pass;
 
                 else if (scan("position")) {
                         searchThread = stopSearch(self, searchThread);
@@ -210,7 +307,7 @@ void uciMain(Engine_t self)
                         if (scan("moves"))
                                 for (int n=1; n>0; line+=n) {
                                         int moves[maxMoves], move;
-                                        int nrMoves = generateMoves(board(self), moves);
+                                        int nrMoves = generateMoves(board(self), moves, generateAll);
                                         n = parseUciMove(board(self), line, moves, nrMoves, &move);
                                         if (n > 0 && move > 0) makeMove(board(self), move);
                                         else if (n > 0) { skipOneToken("Illegal move"); break; }
@@ -233,6 +330,8 @@ void uciMain(Engine_t self)
                 else if (scan("go")) {
                         searchThread = stopSearch(self, searchThread);
                         updateOptions(self, &oldOptions, &newOptions);
+                        latency.goTime = xTime(); // Not counting any one-time work above
+                        latency.ponderhitTime = 0.0;
 
                         self->infoFunction = uciSearchInfo;
                         self->infoData = self;
@@ -259,7 +358,7 @@ void uciMain(Engine_t self)
                                         pass;
                                 else if (scan("searchmoves")) {
                                         int moves[maxMoves], move;
-                                        int nrMoves = generateMoves(board(self), moves);
+                                        int nrMoves = generateMoves(board(self), moves, generateAll);
                                         int n = parseUciMove(board(self), line, moves, nrMoves, &move);
                                         while (n > 0) {
                                                 if (move > 0) { pushList(self->searchMoves, move); line += n; }
@@ -270,9 +369,14 @@ void uciMain(Engine_t self)
 
                         if (sideToMove(board(self)) == black)
                                 time = btime, inc = binc;
-                        setTimeTargets(self, time * ms, inc * ms, movestogo, movetime * ms);
+                        double overhead = latencyPercentile(overheadPhase, 0.99)
+                                        + oldOptions.MoveOverhead * ms;
+                        setTimeTargets(self, time * ms, inc * ms, movestogo, movetime * ms, overhead);
+                        uciRecord('#', "target time %.3f maxtime %.3f overhead %.3f",
+                                self->target.time, self->target.maxTime, overhead);
                         self->target.scores.v[0] = minMate - 2 * min(0, mate); // for "mate -n"
                         self->target.scores.v[1] = maxMate - 2 * max(0, mate); // for "mate n"
+                        latency.parsedTime = xTime();
                         searchThread = startSearch(self);
                 }
                 else if (scan("stop")) {
@@ -280,12 +384,18 @@ void uciMain(Engine_t self)
                         searchThread = stopSearch(self, searchThread);
                 }
                 else if (scan("ponderhit")) {
-                        if (self->pondering)
+                        if (self->pondering) {
+                                latency.ponderhitTime = xTime();
                                 self->alarmHandle = setAlarm(self->target.maxTime, abortSearch, self);
-                        self->pondering = false;
+                                latency.ponderhitAlarm = xTime() - latency.ponderhitTime;
+                        }
+                        self->pondering = false; // Then the search thread reads the above
                 }
                 else if (scan("quit")) {
                         skipOtherTokens();
+                        searchThread = stopSearch(self, searchThread);
+                        if (latency.count[totalPhase] > 0)
+                                uciLatency();
                         break; // leaving the readline loop
                 }
 
@@ -306,10 +416,31 @@ void uciMain(Engine_t self)
                         scanValue("bestof %d", &bestof);
                         uciBenchmark(self, movetime * ms, bestof);
                 }
+                else if (scan("scaling")) {
+                        updateOptions(self, &oldOptions, &newOptions);
+                        int depth = 6, repeat = 3;
+                        long lowHash = 1, highHash = 64;
+                        int threads = 1;
+                        scanValue("depth %d", &depth);
+                        scanValue("repeat %d", &repeat);
+                        scanValue("minhash %ld", &lowHash);
+                        scanValue("maxhash %ld", &highHash);
+                        scanValue("threads %d", &threads);
+                        uciScaling(self, depth, repeat, lowHash, min(highHash, maxHash), threads);
+                }
                 else if (scan("moves")) {
-                        int depth = 1;
+                        int depth = 1, threads = 0;
                         scanValue("depth %d", &depth);
-                        uciMoves(board(self), depth);
+                        scanValue("threads %d", &threads);
+                        uciMoves(board(self), depth, threads);
+                }
+                else if (scan("stats")) {
+                        searchThread = stopSearch(self, searchThread);
+                        uciStats(self);
+                }
+                else if (scan("latency")) {
+                        searchThread = stopSearch(self, searchThread);
+                        uciLatency();
                 }
                 else
                         skipOneToken("Command");
@@ -320,6 +451,28 @@ void uciMain(Engine_t self)
 
         searchThread = stopSearch(self, searchThread);
         freeList(lineBuffer);
+
+        newOptions.RecordFile[0] = '\0';
+        startRecording(&newOptions); // Only closes the file
+        destroyLock(recordLock);
+        recordLock = null;
+}
+
+/*----------------------------------------------------------------------+
+ |      scanSearchParameter                                             |
+ +----------------------------------------------------------------------*/
+
+// Hidden options for search experiments, see params.h
+static int scanSearchParameter(char **line, int searchParams[])
+{
+        for (int i=0; i<searchVectorLen; i++) {
+                char format[128];
+                snprintf(format, sizeof format, " name %s value %%d%%c %%n", searchLabels[i]);
+                int n = _scanToken(line, format, &searchParams[i]);
+                if (n > 0)
+                        return n;
+        }
+        return 0;
 }
 
 /*----------------------------------------------------------------------+
@@ -333,9 +486,76 @@ static void updateOptions(Engine_t self,
                 ttSetSize(self, max(0, newOptions->Hash) * MiB);
         if (newOptions->ClearHash != oldOptions->ClearHash)
                 ttClearFast(self);
+        if (newOptions->HashPolicy != oldOptions->HashPolicy)
+                self->tt.policy = newOptions->HashPolicy;
+        if (strcmp(newOptions->RecordFile, oldOptions->RecordFile) != 0)
+                startRecording(newOptions);
+        if (memcmp(newOptions->searchParams, oldOptions->searchParams, sizeof newOptions->searchParams) != 0)
+                memcpy(searchVector, newOptions->searchParams, sizeof newOptions->searchParams);
         *oldOptions = *newOptions;
 }
 
+/*----------------------------------------------------------------------+
+ |      uciRecord                                                       |
+ +----------------------------------------------------------------------*/
+
+/*
+ *  A record has one line per event: the seconds since the start, a kind
+ *  and the text. Kind `>' is an input line, `<' is an output line, and
+ *  `#' is a note, such as the time targets after `go'. Of the output,
+ *  only `info' from the search, `bestmove' and `readyok' are recorded.
+ *  Each line is flushed right away, so nothing is lost on a crash.
+ */
+static void uciRecord(char kind, const char *format, ...)
+{
+        if (!recordLock)
+                return; // Not from uciMain
+
+        char text[1024];
+        va_list ap;
+        va_start(ap, format);
+        vsnprintf(text, sizeof text, format, ap);
+        va_end(ap);
+
+        int len = strlen(text);
+        while (len > 0 && isspace(text[len-1]))
+                len--;
+
+        // Both the main and the search thread write here
+        acquireLock(recordLock);
+        if (recordFile) {
+                fprintf(recordFile, "%.6f %c %.*s\n", xTime() - recordStartTime, kind, len, text);
+                fflush(recordFile);
+        }
+        releaseLock(recordLock);
+}
+
+// Also when a search is running, because `isready' is allowed then
+static void startRecording(const struct options *options)
+{
+        FILE *fp = null;
+        if (options->RecordFile[0] != '\0') {
+                fp = fopen(options->RecordFile, "w");
+                if (!fp)
+                        printf("info string Cannot open record file %s\n", options->RecordFile);
+        }
+
+        acquireLock(recordLock);
+        if (recordFile)
+                fclose(recordFile);
+        recordStartTime = xTime();
+        recordFile = fp;
+        releaseLock(recordLock);
+
+        if (!fp)
+                return;
+        uciRecord('#', "Floyd "quote2(floydVersion)" record");
+        // The options that matter for replaying
+        uciRecord('#', "option name Hash value %ld", options->Hash);
+        uciRecord('#', "option name Hash Policy value %s",
+                (options->HashPolicy == ttTwoTierPolicy) ? "twotier" : "age");
+}
+
 /*----------------------------------------------------------------------+
  |      uciSearchInfo                                                   |
  +----------------------------------------------------------------------*/
@@ -343,37 +563,38 @@ static void updateOptions(Engine_t self,
 void uciSearchInfo(void *uciInfoData)
 {
         Engine_t self = uciInfoData;
-        charList infoLine = emptyList; // Construct the info line in a thread-safe manner
+        charList *infoLine = &self->infoLine; // Only used by the search thread
+        infoLine->len = 0;
 
         long milliSeconds = round(self->seconds / ms);
-        listPrintf(&infoLine, "info time %ld", milliSeconds);
+        listPrintf(infoLine, "info time %ld", milliSeconds);
 
         if (self->pv.len > 0 || self->depth == 0) {
-                listPrintf(&infoLine, " depth %d score ", self->depth);
+                listPrintf(infoLine, " depth %d score ", self->depth);
                 if (isMateScore(self->score))
-                        listPrintf(&infoLine, "mate %d",
+                        listPrintf(infoLine, "mate %d",
                                 (self->score < 0) ? (minMate - self->score    ) / 2
                                                   : (maxMate - self->score + 1) / 2);
                 else
-                        listPrintf(&infoLine, "cp %.0f", round(self->score / 10.0));
+                        listPrintf(infoLine, "cp %.0f", round(self->score / 10.0));
         }
 
         double nps = (self->seconds > 0.0) ? self->nodeCount / self->seconds : 0.0;
-        listPrintf(&infoLine, " nodes %lld nps %.0f", self->nodeCount, nps);
+        listPrintf(infoLine, " nodes %lld nps %.0f", self->nodeCount, nps);
 
         double ttLoad = ttCalcLoad(self);
-        listPrintf(&infoLine, " hashfull %d", (int) round(ttLoad * 1000.0));
+        listPrintf(infoLine, " hashfull %d", (int) round(ttLoad * 1000.0));
 
         for (int i=0; i<self->pv.len; i++) {
                 char moveString[maxMoveSize];
                 moveToUci(moveString, self->pv.v[i]);
-                listPrintf(&infoLine, "%s %s", (i == 0) ? " pv" : "", moveString);
+                listPrintf(infoLine, "%s %s", (i == 0) ? " pv" : "", moveString);
         }
 
-        puts(infoLine.v); // Should be atomic and adds a newline
+        puts(infoLine->v); // Should be atomic and adds a newline
+        uciRecord('<', "%s", infoLine->v);
         if (self->seconds >= 0.1)
                 fflush(stdout);
-        freeList(infoLine);
 }
 
 /*----------------------------------------------------------------------+
@@ -383,19 +604,111 @@ void uciSearchInfo(void *uciInfoData)
 static void uciBestMove(Engine_t self)
 {
         char moveString[maxMoveSize];
+        char reply[64];
+        int len;
 
         if (self->bestMove) {
                 moveToUci(moveString, self->bestMove);
-                printf("bestmove %s", moveString);
+                len = sprintf(reply, "bestmove %s", moveString);
         } else
-                printf("bestmove 0000"); // When in doubt, do as Shredder
+                len = sprintf(reply, "bestmove 0000"); // When in doubt, do as Shredder
 
         if (self->ponderMove) {
                 moveToUci(moveString, self->ponderMove);
-                printf(" ponder %s", moveString);
+                sprintf(reply + len, " ponder %s", moveString);
         }
-        putchar('\n');
+        puts(reply);
         fflush(stdout);
+        uciRecord('<', "%s", reply);
+}
+
+/*----------------------------------------------------------------------+
+ |      uciStats                                                        |
+ +----------------------------------------------------------------------*/
+
+static void uciStats(Engine_t self)
+{
+        printf("info string nodes %lld rootresearches %lld rescues %lld rescuecuts %lld"
+               " nullmoves %lld nullcuts %lld nullconfirms %lld\n",
+                self->nodeCount, self->stats.rootResearches, self->stats.rescues, self->stats.rescueCuts,
+                self->stats.nullMoves, self->stats.nullCuts, self->stats.nullConfirms);
+        printf("info string futilitytests %lld futilityprunes %lld futilityerrors %lld\n",
+                self->stats.futilityTests, self->stats.futilityPrunes, self->stats.futilityErrors);
+        printf("info string deltatests %lld deltaprunes %lld deltaerrors %lld\n",
+                self->stats.deltaTests, self->stats.deltaPrunes, self->stats.deltaErrors);
+        printf("info string ttprobes %lld tthits %lld ttstores %lld ttevictions %lld etctests %lld etccuts %lld\n",
+                self->stats.ttProbes, self->stats.ttHits, self->stats.ttStores, self->stats.ttEvictions,
+                self->stats.etcTests, self->stats.etcCuts);
+
+        long long sumNodeCount = 0;
+        for (int i=0; i<self->rootMoves.len; i++)
+                sumNodeCount += self->rootMoves.v[i].nodeCount;
+
+        for (int i=0; i<self->rootMoves.len; i++) {
+                char moveString[maxMoveSize];
+                moveToUci(moveString, self->rootMoves.v[i].move);
+                printf("info string move %s", moveString);
+                int score = self->rootMoves.v[i].score;
+                if (score != minInt) // Not searched yet
+                        printf(" score %.0f", round(score / 10.0));
+                long long nodeCount = self->rootMoves.v[i].nodeCount;
+                printf(" nodes %lld effort %.1f%%\n", nodeCount,
+                        (sumNodeCount > 0) ? 100.0 * nodeCount / sumNodeCount : 0.0);
+        }
+}
+
+/*----------------------------------------------------------------------+
+ |      uciLatency                                                      |
+ +----------------------------------------------------------------------*/
+
+/*
+ *  Bucket i counts the times from 2^i up to 2^(i+1) microseconds.
+ *  Percentiles are reported as the upper bound of their bucket, so
+ *  they err on the safe side when used for the move overhead.
+ */
+static void addLatency(int phase, double seconds)
+{
+        long long micros = seconds / us;
+        int i = 0;
+        while (micros > 1 && i < nrLatencyBuckets - 1)
+                micros >>= 1, i++;
+
+        latency.buckets[phase][i]++;
+        latency.count[phase]++;
+        latency.sum[phase] += seconds;
+        latency.max[phase] = max(latency.max[phase], seconds);
+}
+
+static double latencyPercentile(int phase, double fraction)
+{
+        long long n = ceil(fraction * latency.count[phase]);
+        for (int i=0; i<nrLatencyBuckets; i++) {
+                n -= latency.buckets[phase][i];
+                if (n <= 0)
+                        return min((2LL << i) * us, latency.max[phase]);
+        }
+        return 0.0;
+}
+
+static void uciLatency(void)
+{
+        for (int phase=0; phase<nrLatencyPhases; phase++) {
+                long long count = latency.count[phase];
+                printf("info string latency %s count %lld mean %.3f p50 %.3f p90 %.3f p99 %.3f max %.3f ms\n",
+                        latencyNames[phase], count,
+                        (count > 0) ? latency.sum[phase] / count / ms : 0.0,
+                        latencyPercentile(phase, 0.50) / ms,
+                        latencyPercentile(phase, 0.90) / ms,
+                        latencyPercentile(phase, 0.99) / ms,
+                        latency.max[phase] / ms);
+        }
+        for (int phase=0; phase<nrLatencyPhases; phase++) {
+                printf("info string histogram %s", latencyNames[phase]);
+                for (int i=0; i<nrLatencyBuckets; i++)
+                        if (latency.buckets[phase][i] > 0)
+                                printf(" %g:%lld", (2LL << i) * us / ms, latency.buckets[phase][i]);
+                putchar('\n');
+        }
 }
 
 /*----------------------------------------------------------------------+
@@ -405,10 +718,39 @@ static void uciBestMove(Engine_t self)
 static void searchThreadStart(void *args)
 {
         Engine_t self = args;
+        double startTime = xTime();
+        bool withAlarm = self->target.maxTime > 0.0 && !self->pondering;
+
         rootSearch(self);
+        double searchedTime = xTime();
         while (self->pondering)
                 pass; // TODO: change into a sempahore
+        double waitedTime = xTime();
+
         uciBestMove(self);
+        double flushedTime = xTime();
+
+        // Only the main thread reads these, after joining this thread
+        bool ponderhit = latency.ponderhitTime > 0.0;
+        double parse = latency.parsedTime - latency.goTime;
+        double thread = startTime - latency.parsedTime;
+        double alarm = withAlarm ? self->alarmSeconds : ponderhit ? latency.ponderhitAlarm : 0.0;
+        double output = flushedTime - waitedTime;
+        addLatency(parsePhase, parse);
+        addLatency(threadPhase, thread);
+        if (withAlarm || ponderhit)
+                addLatency(alarmPhase, alarm);
+        addLatency(outputPhase, output);
+        addLatency(overheadPhase, parse + thread + alarm + output);
+        if (withAlarm) {
+                double search = searchedTime - startTime - alarm;
+                addLatency(searchPhase, search);
+                addLatency(totalPhase, parse + thread + alarm + search + output);
+        } else if (ponderhit) { // The search may even have finished before
+                double search = max(0.0, searchedTime - latency.ponderhitTime - alarm);
+                addLatency(searchPhase, search);
+                addLatency(totalPhase, flushedTime - latency.ponderhitTime);
+        }
 }
 
 static xThread_t startSearch(Engine_t args)
@@ -3,6 +3,7 @@ searchInfo_fn uciSearchInfo;
 void uciMain(Engine_t self);
 
 void uciBenchmark(Engine_t self, double time, int bestOf);
-void uciMoves(Board_t self, int depth);
+void uciScaling(Engine_t self, int depth, int repeat, long minHash, long maxHash, int nrThreads);
+void uciMoves(Board_t self, int depth, int nrThreads);
 
 
@@ -6,6 +6,7 @@
 
 // C standard
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 // C extension
@@ -0,0 +1,169 @@
+#!/usr/bin/env python
+#-----------------------------------------------------------------------
+#
+#       benchcompare.py -- compare the speed of two engine builds
+#
+#       Usage:
+#         python benchcompare.py [<option> ...] <baseline> <candidate>
+#
+#       Both engines run as UCI processes side by side. Each bench
+#       position (from Source/test.c) is searched with a fixed node budget,
+#       by one engine and then right away by the other, so that thermal
+#       drift and background load hit both alike. The order flips every
+#       round. The speedup is the geometric mean of the nps ratios per
+#       position, with a 95% confidence interval and a t-test against the
+#       allowed slowdown.
+#
+#       Exits with status 1 when the candidate is significantly slower than
+#       the baseline by more than the threshold: the whole interval is below
+#       1 - threshold.
+#
+#       Options:
+#         -n <nodes>      Node budget per search (default 200000)
+#         -r <rounds>     Rounds over all positions (default 3)
+#         -t <threshold>  Allowed slowdown (default 0.01, so 1%)
+#
+#-----------------------------------------------------------------------
+
+import math
+import re
+import subprocess
+import sys
+
+#-----------------------------------------------------------------------
+#       Options
+#-----------------------------------------------------------------------
+
+nodes = 200000   # -n
+rounds = 3       # -r
+threshold = 0.01 # -t
+
+# Significance level of the t-test
+alpha = 0.05
+
+#-----------------------------------------------------------------------
+#       Engine
+#-----------------------------------------------------------------------
+
+class Engine:
+        def __init__(self, command):
+                self.process = subprocess.Popen([command], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+                self.send('isready')
+                self.waitFor('readyok')
+
+        def send(self, line):
+                self.process.stdin.write(line + '\n')
+                self.process.stdin.flush()
+
+        def waitFor(self, prefix):
+                lines = []
+                while True:
+                        line = self.process.stdout.readline()
+                        if not line:
+                                raise IOError('engine quit unexpectedly')
+                        lines.append(line)
+                        if line.startswith(prefix):
+                                return lines
+
+        def nps(self, fen):
+                """Speed of a fixed node search from a cleared hash table, or
+                None when the search reported no usable nps, such as when it
+                ended at once"""
+                self.send('setoption name Clear Hash')
+                self.send('isready')
+                self.waitFor('readyok')
+                self.send('position fen ' + fen)
+                self.send('go nodes %d' % nodes)
+                last = None
+                for line in self.waitFor('bestmove'):
+                        match = re.search(r' nps (\d+)', line)
+                        if match:
+                                last = int(match.group(1))
+                return last if last else None
+
+        def quit(self):
+                self.send('quit')
+                self.process.wait()
+
+#-----------------------------------------------------------------------
+#       Statistics
+#-----------------------------------------------------------------------
+
+def tTest(x, mu):
+        """Mean, half width of the 95% interval, and the two-sided p-value
+        for mean `mu'. Normal approximation, fine for the usual 40+ samples."""
+        n = len(x)
+        mean = sum(x) / n
+        variance = sum((xi - mean) ** 2 for xi in x) / max(1, n - 1)
+        se = math.sqrt(variance / n)
+        t = (mean - mu) / se if se > 0.0 else float('+Inf') * cmp(mean, mu)
+        p = math.erfc(abs(t) / math.sqrt(2.0)) if se > 0.0 else float(mean == mu)
+        return mean, 1.96 * se, p
+
+#-----------------------------------------------------------------------
+#       readPositions
+#-----------------------------------------------------------------------
+
+def readPositions(filename):
+        with open(filename, 'r') as fp:
+                source = fp.read()
+        block = source[source.index('positions[] = {'):]
+        block = block[:block.index('};')]
+        return re.findall(r'"([^"]+)"', block)
+
+#-----------------------------------------------------------------------
+#       main
+#-----------------------------------------------------------------------
+
+if __name__ == '__main__':
+        args = sys.argv[1:]
+        while len(args) >= 2 and args[0] in ('-n', '-r', '-t'):
+                if args[0] == '-n': nodes = int(args[1])
+                if args[0] == '-r': rounds = int(args[1])
+                if args[0] == '-t': threshold = float(args[1])
+                args = args[2:]
+        if len(args) != 2:
+                print >>sys.stderr, 'Usage: benchcompare.py [-n <nodes>] [-r <rounds>] [-t <threshold>] <baseline> <candidate>'
+                sys.exit(2)
+
+        positions = readPositions('Source/test.c')
+        baseline, candidate = Engine(args[0]), Engine(args[1])
+
+        logRatios = []
+        for r in range(rounds):
+                for i, fen in enumerate(positions):
+                        if r % 2 == 0:
+                                a = baseline.nps(fen)
+                                b = candidate.nps(fen)
+                        else:
+                                b = candidate.nps(fen)
+                                a = baseline.nps(fen)
+                        if a is None or b is None:
+                                print >>sys.stderr, 'warning: round %d position %d skipped (no nps)' % (r + 1, i + 1)
+                                continue
+                        logRatios.append(math.log(float(b) / a))
+                        print 'round %d position %2d baseline %8d candidate %8d ratio %.4f' % (
+                                r + 1, i + 1, a, b, float(b) / a)
+                        sys.stdout.flush()
+        baseline.quit()
+        candidate.quit()
+        if len(logRatios) == 0:
+                print >>sys.stderr, 'benchcompare.py: no positions measured'
+                sys.exit(2)
+
+        limit = math.log(1.0 - threshold)
+        mean, halfWidth, p = tTest(logRatios, limit)
+        speedup = math.exp(mean)
+        print 'result speedup %.4f interval %.4f %.4f samples %d p %.4f (against %.4f)' % (
+                speedup, math.exp(mean - halfWidth), math.exp(mean + halfWidth), len(logRatios),
+                p, 1.0 - threshold)
+
+        if mean < limit and p < alpha: # Also the upper bound of the interval
+                print 'result FAIL candidate is slower by %.1f%%' % (100.0 * (1.0 - speedup))
+                sys.exit(1)
+        print 'result OK'
+
+#-----------------------------------------------------------------------
+#
+#-----------------------------------------------------------------------
+
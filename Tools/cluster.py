@@ -0,0 +1,351 @@
+#!/usr/bin/env python
+#-----------------------------------------------------------------------
+#
+#       cluster.py -- spread residual and test suite runs over workers
+#
+#       Usage:
+#         python cluster.py residual [<option> ...] [<vector.json>] < positions.epd
+#         python cluster.py epdtest [<option> ...] <movetime> < tests.epd
+#         python cluster.py worker [-n <count>] [-r] <address>
+#
+#       The coordinator (`residual' or `epdtest') reads its input, cuts it
+#       into shards and listens for workers. Each worker handles one shard
+#       at a time with the floyd module and sends back its partial result.
+#       When a worker goes away, its shard is handed to another one. When
+#       a worker stays silent for too long (-t), its shard is also handed
+#       to an idle worker, and whichever result comes first is used.
+#
+#       An address is <host>:<port> for TCP or a path for a Unix socket.
+#       Workers can connect from other hosts and can join at any time.
+#       With -n the coordinator starts workers on localhost by itself, so:
+#         python Tools/cluster.py residual -n 4 < positions.epd
+#       needs nothing else running. Elsewhere, start with for example:
+#         python Tools/cluster.py worker -n 8 -r coordinator.lan:7340
+#
+#       `residual' gives the same number as `tune.py -q'. The vector file
+#       is in the format of tune.py or updateDefaults.py, and coefficients
+#       not in it keep their default value.
+#
+#       Coordinator options:
+#         -l <address>  Listen address (default localhost:7340)
+#         -n <count>    Start this many workers on localhost (default 0)
+#         -s <size>     Lines per shard (default 500 for residual, 4 for epdtest)
+#         -t <seconds>  Duplicate shards of silent workers after this (default 300)
+#         -d <depth>    Search depth for residual, 0 is qSearch only (default 0)
+#
+#       Worker options:
+#         -n <count>    Number of worker processes (default cpu count)
+#         -r            Reconnect for the next run when the coordinator is done
+#
+#       Protocol: plain text, one JSON object per line in both directions.
+#         coordinator: {"shard": <id>, "task": "residual", "lines": [..],
+#                       "depth": <depth>, "vector": {<name>: <value>, ..}}
+#                      {"shard": <id>, "task": "epdtest", "lines": [..],
+#                       "first": <line number>, "movetime": <seconds>}
+#         worker:      {"shard": <id>, "result": [<sumSquaredErrors>, <count>]}
+#                      {"shard": <id>, "result": [[<passed>, <report>], ..]}
+#       The coordinator closes the connection when all shards are done.
+#
+#-----------------------------------------------------------------------
+
+import json
+import multiprocessing
+import os
+import select
+import socket
+import subprocess
+import sys
+import time
+
+#-----------------------------------------------------------------------
+#       Definitions
+#-----------------------------------------------------------------------
+
+defaultAddress = 'localhost:7340'
+defaultShardSize = { 'residual': 500, 'epdtest': 4 }
+
+# How long a worker keeps trying to reach the coordinator (without -r)
+connectTimeout = 60.0
+
+#-----------------------------------------------------------------------
+#       Sockets
+#-----------------------------------------------------------------------
+
+def parseAddress(address):
+        """Return (family, sockaddr) for <host>:<port> or a Unix socket path"""
+        host, sep, port = address.rpartition(':')
+        if sep and port.isdigit() and '/' not in address:
+                return socket.AF_INET, (host or 'localhost', int(port))
+        return socket.AF_UNIX, address
+
+def listen(address):
+        family, sockaddr = parseAddress(address)
+        sock = socket.socket(family, socket.SOCK_STREAM)
+        if family == socket.AF_UNIX:
+                if os.path.exists(sockaddr):
+                        os.unlink(sockaddr)
+        else:
+                sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        sock.bind(sockaddr)
+        sock.listen(64)
+        return sock
+
+def connect(address, timeout):
+        """Keep trying until the coordinator is there, or return None"""
+        family, sockaddr = parseAddress(address)
+        deadline = time.time() + timeout
+        while True:
+                sock = socket.socket(family, socket.SOCK_STREAM)
+                try:
+                        sock.connect(sockaddr)
+                        return sock
+                except socket.error:
+                        sock.close()
+                        if time.time() > deadline:
+                                return None
+                        time.sleep(1.0)
+
+def send(sock, message):
+        sock.sendall(json.dumps(message, separators=(',', ':')) + '\n')
+
+#-----------------------------------------------------------------------
+#       Worker
+#-----------------------------------------------------------------------
+
+def runResidual(message):
+        import floyd as engine
+        import tune
+        vector = engine.Vector()
+        labels = list(engine.vectorLabels)
+        for name, value in message['vector'].items():
+                vector[labels.index(name)] = value
+        sumSquaredErrors = 0.0
+        tests = tune.readTestsFromEpd(message['lines'])
+        for pos, target in tests:
+                score, move = engine.search(pos, message['depth'], vector=vector)
+                p = tune.scoreToP(score)
+                sumSquaredErrors += (p - target) * (p - target)
+        return [sumSquaredErrors, len(tests)]
+
+def runEpdTest(message):
+        import epdtest
+        results = []
+        for i, rawLine in enumerate(message['lines'], message['first']):
+                passed, report = epdtest.testLine(i, rawLine, message['movetime'])
+                results.append([passed, report])
+        return results
+
+tasks = { 'residual': runResidual, 'epdtest': runEpdTest }
+
+def serve(sock):
+        """Handle shards until the coordinator closes the connection"""
+        input = sock.makefile('r')
+        for line in input:
+                message = json.loads(line)
+                result = tasks[message['task']](message)
+                send(sock, {'shard': message['shard'], 'result': result})
+        input.close()
+
+def runWorker(address, repeat):
+        while True:
+                sock = connect(address, float('+Inf') if repeat else connectTimeout)
+                if sock is None:
+                        print >>sys.stderr, 'worker: no coordinator at', address
+                        return
+                try:
+                        serve(sock)
+                except socket.error as err:
+                        print >>sys.stderr, 'worker:', err
+                sock.close()
+                if not repeat:
+                        return
+
+def startWorkers(count, address, repeat):
+        workers = [multiprocessing.Process(target=runWorker, args=(address, repeat))
+                   for x in range(count)]
+        for process in workers:
+                process.start()
+        for process in workers:
+                process.join()
+
+#-----------------------------------------------------------------------
+#       Coordinator
+#-----------------------------------------------------------------------
+
+class Connection:
+        def __init__(self, sock):
+                self.sock = sock
+                self.buffer = ''
+                self.shard = None  # Shard being worked on, if any
+                self.since = None  # When it was sent
+
+def coordinate(listener, shards, timeout, local):
+        """Hand out shards until all have a result. Return the results by shard id"""
+        pending = range(len(shards))
+        results = {}
+        connections = {}
+        while len(results) < len(shards):
+
+                # Don't wait forever when only local workers were expected and all have died
+                if local and not connections and all(p.poll() is not None for p in local):
+                        print >>sys.stderr, '\ncluster: all local workers have exited'
+                        sys.exit(1)
+
+                # Give work to idle workers: first the pending shards, then
+                # copies of shards that are taking too long somewhere else
+                now = time.time()
+                for conn in connections.values():
+                        if conn.shard is not None:
+                                continue
+                        if not pending:
+                                late = [c.shard for c in connections.values()
+                                        if c.shard is not None and now - c.since > timeout]
+                                late = [s for s in late if s not in results and
+                                        sum(c.shard == s for c in connections.values()) < 2]
+                                if not late:
+                                        break
+                                print >>sys.stderr, '\ncluster: shard %d is late, sending it again' % late[0]
+                                pending.append(late[0])
+                        conn.shard, conn.since = pending.pop(0), now
+                        try:
+                                send(conn.sock, shards[conn.shard])
+                        except socket.error:
+                                pass # Noticed as a lost worker below
+
+                readable, _, _ = select.select([listener] + connections.keys(), [], [], 1.0)
+                for sock in readable:
+                        if sock is listener:
+                                newSock, _ = listener.accept()
+                                connections[newSock] = Connection(newSock)
+                                continue
+
+                        conn = connections[sock]
+                        try:
+                                data = sock.recv(65536)
+                        except socket.error:
+                                data = ''
+                        if not data:
+                                # Lost worker: give its shard to another one
+                                if conn.shard is not None and conn.shard not in results:
+                                        print >>sys.stderr, '\ncluster: lost a worker, requeuing shard %d' % conn.shard
+                                        if conn.shard not in pending:
+                                                pending.insert(0, conn.shard)
+                                sock.close()
+                                del connections[sock]
+                                continue
+
+                        conn.buffer += data
+                        while '\n' in conn.buffer:
+                                line, conn.buffer = conn.buffer.split('\n', 1)
+                                message = json.loads(line)
+                                results.setdefault(message['shard'], message['result'])
+                                conn.shard = None
+                                if message['shard'] in pending:
+                                        pending.remove(message['shard'])
+                        sys.stderr.write('\rcluster: shards %d/%d workers %d' % (
+                                len(results), len(shards), len(connections)))
+
+        sys.stderr.write('\n')
+        for sock in connections:
+                sock.close()
+        return [results[i] for i in range(len(shards))]
+
+def startLocalWorkers(count, address):
+        return [subprocess.Popen([sys.executable, os.path.abspath(__file__), 'worker', '-n', '1', address])
+                for x in range(count)]
+
+def readVector(filename):
+        """Coefficients from a tune.py or updateDefaults.py JSON file"""
+        if filename is None:
+                return {}
+        with open(filename, 'r') as fp:
+                jsonVector, history = json.load(fp)
+        return dict((item[0], item[1]) for item in jsonVector)
+
+#-----------------------------------------------------------------------
+#       main
+#-----------------------------------------------------------------------
+
+def usage():
+        print >>sys.stderr, 'Usage: cluster.py residual [<option> ...] [<vector.json>] < positions.epd'
+        print >>sys.stderr, '       cluster.py epdtest [<option> ...] <movetime> < tests.epd'
+        print >>sys.stderr, '       cluster.py worker [-n <count>] [-r] <address>'
+        sys.exit(1)
+
+if __name__ == '__main__':
+        args = sys.argv[1:]
+        if len(args) == 0:
+                usage()
+        mode, args = args[0], args[1:]
+
+        if mode == 'worker':
+                count, repeat = multiprocessing.cpu_count(), False
+                while len(args) > 0 and args[0][0] == '-':
+                        if args[0] == '-n':
+                                count, args = int(args[1]), args[2:]
+                        elif args[0] == '-r':
+                                repeat, args = True, args[1:]
+                        else:
+                                usage()
+                if len(args) != 1:
+                        usage()
+                startWorkers(count, args[0], repeat)
+                sys.exit(0)
+
+        if mode not in tasks:
+                usage()
+
+        address, nrLocal, shardSize, timeout, depth = defaultAddress, 0, defaultShardSize[mode], 300.0, 0
+        while len(args) > 0 and args[0][0] == '-' and len(args) >= 2:
+                option, value, args = args[0], args[1], args[2:]
+                if   option == '-l': address = value
+                elif option == '-n': nrLocal = int(value)
+                elif option == '-s': shardSize = int(value)
+                elif option == '-t': timeout = float(value)
+                elif option == '-d': depth = int(value)
+                else: usage()
+
+        lines = [line for line in sys.stdin if line.strip()]
+        shards = []
+        for first in range(0, len(lines), shardSize):
+                shard = {'shard': len(shards), 'task': mode, 'lines': lines[first:first+shardSize]}
+                shards.append(shard)
+
+        if mode == 'residual':
+                if len(args) > 1:
+                        usage()
+                vector = readVector(args[0] if args else None)
+                for shard in shards:
+                        shard.update({'depth': depth, 'vector': vector})
+        else:
+                if len(args) != 1:
+                        usage()
+                for shard in shards:
+                        shard.update({'first': shard['shard'] * shardSize + 1, 'movetime': float(args[0])})
+
+        listener = listen(address)
+        local = startLocalWorkers(nrLocal, address)
+        results = coordinate(listener, shards, timeout, local)
+        listener.close()
+        if parseAddress(address)[0] == socket.AF_UNIX:
+                os.unlink(address)
+        for process in local:
+                process.wait()
+
+        if mode == 'residual':
+                sumSquaredErrors = sum(result[0] for result in results)
+                nrTests = sum(result[1] for result in results)
+                residual = (sumSquaredErrors / nrTests) ** 0.5 if nrTests > 0 else 0.0
+                print 'residual %.9f positions %d depth %d' % (residual, nrTests, depth)
+        else:
+                nrPassed = 0
+                for result in results:
+                        for passed, report in result:
+                                print report,
+                                nrPassed += passed
+                print 'passed %d total %d' % (nrPassed, len(lines))
+
+#-----------------------------------------------------------------------
+#
+#-----------------------------------------------------------------------
+
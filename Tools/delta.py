@@ -0,0 +1,160 @@
+#!/usr/bin/env python
+#-----------------------------------------------------------------------
+#
+#       delta.py -- fit the delta pruning margins from search samples
+#
+#       Usage:
+#         python delta.py [-e <errorRate>] <samples> > delta.json
+#
+#       The samples come from `futility.py collect'. Delta pruning is
+#       disabled while sampling, so each capture in quiescence search is
+#       recorded with the score it really got.
+#
+#       Shows a histogram of the score gains per cell of the margin table
+#       (material phase, SEE value), and the prune and error rates of the
+#       old and new margins. Writes the new table as JSON for
+#       updateDefaults.py and as UCI `setoption' commands.
+#
+#-----------------------------------------------------------------------
+
+import json
+import sys
+
+#-----------------------------------------------------------------------
+#       Definitions
+#-----------------------------------------------------------------------
+
+# Allowed fraction of pruned captures that would have failed high (-e)
+errorRate = 0.01
+
+# Cells with fewer samples keep their old margin
+minSamples = 100
+
+maxEval = 29999
+nrPhases = 4
+nrBuckets = 9 # SEE values 0..7 and 8 or more
+pawn = 1000
+
+def oldMargin(see, phase):
+        return 1200 * see + 1450
+
+#-----------------------------------------------------------------------
+#       readSamples
+#-----------------------------------------------------------------------
+
+def readSamples(filename):
+        """Read delta samples, skipping mate scores and other record types"""
+        samples = []
+        with open(filename, 'r') as fp:
+                for line in fp:
+                        fields = line.split()
+                        if fields[0] != 'delta':
+                                continue
+                        see, phase, base, alpha, score = map(int, fields[1:6])
+                        if abs(score) > maxEval:
+                                continue
+                        samples.append((see, phase, base, alpha, score))
+        return samples
+
+#-----------------------------------------------------------------------
+#       histograms
+#-----------------------------------------------------------------------
+
+def histograms(samples):
+        """Gains in pawns per cell: <0, 0, 1, .., 14 and >=15"""
+        cells = {}
+        for see, phase, base, alpha, score in samples:
+                cell = phase, min(see, nrBuckets - 1)
+                gain = (score - base) // pawn
+                bin = max(-1, min(gain, 15)) + 1
+                cells.setdefault(cell, [0] * 17)[bin] += 1
+
+        print >>sys.stderr, 'phase see  count |' + ''.join('%6s' % b for b in ['<0'] + range(15) + ['>=15'])
+        for cell in sorted(cells):
+                counts = cells[cell]
+                print >>sys.stderr, '%5d %3d %6d |%s' % (
+                        cell[0], cell[1], sum(counts), ''.join('%6d' % n for n in counts))
+
+#-----------------------------------------------------------------------
+#       fit
+#-----------------------------------------------------------------------
+
+def fit(samples):
+        """Lower the margin per cell as far as the error rate allows,
+        but keep it non-decreasing in SEE"""
+        needs = {} # The margin needed to prune a capture, and if that would be an error
+        for see, phase, base, alpha, score in samples:
+                bucket = min(see, nrBuckets - 1)
+                extra = (see - bucket) * 1200
+                needs.setdefault((phase, bucket), []).append((alpha - base - extra, score > alpha))
+
+        margins = {}
+        for phase in range(nrPhases):
+                last = None
+                for bucket in range(nrBuckets):
+                        cell = needs.get((phase, bucket), [])
+                        margin = oldMargin(bucket, phase)
+                        if len(cell) >= minSamples:
+                                nrPrunes = nrErrors = 0
+                                for need, isError in sorted(cell, reverse=True):
+                                        nrPrunes += 1
+                                        nrErrors += isError
+                                        if nrErrors <= errorRate * nrPrunes:
+                                                margin = need
+                                margins[phase, bucket] = margin
+                        if last is not None and margin < last:
+                                margin = margins[phase, bucket] = last
+                        last = margin
+        return margins
+
+#-----------------------------------------------------------------------
+#       report
+#-----------------------------------------------------------------------
+
+def report(samples, marginFunction, label):
+        """Show prune and error rates of a margin table on the samples"""
+        nrPrunes = nrErrors = 0
+        for see, phase, base, alpha, score in samples:
+                if marginFunction(see, phase) <= alpha - base:
+                        nrPrunes += 1
+                        nrErrors += score > alpha
+        print >>sys.stderr, '%-8s captures %7d prunes %5.1f%% errors %5.2f%%' % (
+                label, len(samples),
+                100.0 * nrPrunes / max(1, len(samples)),
+                100.0 * nrErrors / max(1, nrPrunes))
+
+#-----------------------------------------------------------------------
+#       main
+#-----------------------------------------------------------------------
+
+if __name__ == '__main__':
+        args = sys.argv[1:]
+        if len(args) >= 2 and args[0] == '-e':
+                errorRate = float(args[1])
+                args = args[2:]
+        if len(args) != 1:
+                print >>sys.stderr, 'Usage: delta.py [-e <errorRate>] <samples> > delta.json'
+                sys.exit(1)
+
+        samples = readSamples(args[0])
+        histograms(samples)
+        margins = fit(samples)
+
+        def newMargin(see, phase):
+                bucket = min(see, nrBuckets - 1)
+                margin = margins.get((phase, bucket), oldMargin(bucket, phase))
+                return margin + (see - bucket) * 1200
+
+        report(samples, oldMargin, 'old')
+        report(samples, newMargin, 'new')
+
+        vector = [['deltaPhase%d_%d' % cell, margin] for cell, margin in sorted(margins.items())]
+        for name, value in vector:
+                print >>sys.stderr, 'setoption name %s value %d' % (name, value)
+        json.dump([vector, []], sys.stdout, indent=1)
+        print
+
+#-----------------------------------------------------------------------
+#
+#-----------------------------------------------------------------------
+
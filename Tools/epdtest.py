@@ -1,5 +1,4 @@
 
-import chessmoves # Source: https://github.com/kervinck/chessmoves.git
 import floyd as engine
 import multiprocessing
 import sys
@@ -37,25 +36,25 @@ def runWorker(pipe, lines, i, moveTime):
         nrPassed = 0
         for rawLine in lines:
                 i += 1
-                pos, operations = parseEpd(rawLine)
-                bm = [chessmoves.move(pos, bm, notation='uci')[0] for bm in operations['bm'].split()] # best move
-                am = [chessmoves.move(pos, am, notation='uci')[0] for am in operations['am'].split()] # avoid move
-                dm = [int(dm) for dm in operations['dm'].split()] # mate distance
-                score, move = engine.search(pos, movetime=moveTime, info=None)
-                mate = None
-                if score >=  31.0: mate =  32.0 - score
-                if score <= -31.0: mate = -32.0 - score
-                if mate is not None:
-                        mate = (int(round(mate * 1000.0)) + 1) // 2
-                if (len(bm) == 0 or move in bm) and\
-                   (len(am) == 0 or move not in am) and\
-                   (len(dm) == 0 or mate in dm):
-                        print '%5d OK  bestmove %-5s score %+7.3f mate %-4s epd %s' % (i, move, score, mate, rawLine),
-                        nrPassed += 1
-                else:
-                        print '%5d NOK bestmove %-5s score %+7.3f mate %-4s epd %s' % (i, move, score, mate, rawLine),
+                passed, report = testLine(i, rawLine, moveTime)
+                print report,
+                nrPassed += passed
         pipe.send((nrPassed, len(lines)))
 
+def testLine(i, rawLine, moveTime):
+        pos, operations = parseEpd(rawLine)
+        bm = [engine.parseMove(pos, bm)[0] for bm in operations['bm'].split()] # best move
+        am = [engine.parseMove(pos, am)[0] for am in operations['am'].split()] # avoid move
+        dm = [int(dm) for dm in operations['dm'].split()] # mate distance
+        result = engine.search(pos, movetime=moveTime, info=None)
+        score, move, mate = result.score, result.move, result.mate
+        passed = (len(bm) == 0 or move in bm) and\
+                 (len(am) == 0 or move not in am) and\
+                 (len(dm) == 0 or mate in dm)
+        report = '%5d %-3s bestmove %-5s score %+7.3f mate %-4s epd %s' % (
+                i, 'OK' if passed else 'NOK', move, score, mate, rawLine)
+        return passed, report
+
 def stopWorkers(workers):
         nrPassed, nrTests = 0, 0
         for process, pipe in workers.items():
@@ -0,0 +1,202 @@
+#!/usr/bin/env python
+#-----------------------------------------------------------------------
+#
+#       futility.py -- fit the futility margin model from search samples
+#
+#       Usage:
+#         python futility.py collect <depth> <samples> < positions.epd
+#         python futility.py fit [-e <errorRate>] <samples> > futility.json
+#
+#       `collect' searches each position and appends the samples of all
+#       frontier and pre-frontier nodes to the samples file. Futility
+#       pruning is disabled for these nodes, so each sample holds the
+#       real search result. The file also gets the samples for delta
+#       pruning in quiescence search, see delta.py.
+#
+#       `fit' writes the fitted parameters as JSON for updateDefaults.py,
+#       for example:
+#         python Tools/updateDefaults.py futility.json < Source/params.h
+#       The same parameters are also shown as UCI `setoption' commands.
+#
+#-----------------------------------------------------------------------
+
+import json
+import sys
+
+#-----------------------------------------------------------------------
+#       Definitions
+#-----------------------------------------------------------------------
+
+# Allowed fraction of pruned nodes that would have failed high (-e)
+errorRate = 0.01
+
+maxEval = 29999
+
+# Must match enum futilityFeature in Board.h and the weights in params.h
+featureNames = [
+        'futilityHanging_0', 'futilityHanging_1', 'futilityHanging_2',
+        'futilityHanging_0X', 'futilityHanging_1X', 'futilityHanging_2X',
+        'futilityPassers', 'futilityPassersX',
+        'futilityKingZone', 'futilityKingZoneX' ]
+
+# Node groups with their own base margin: (depth, odd distance from PV)
+baseNames = {
+        (1, 0): 'futilityBase_1',
+        (1, 1): 'futilityBase_1X',
+        (2, 0): 'futilityBase_2',
+        (2, 1): 'futilityBase_2' }
+
+#-----------------------------------------------------------------------
+#       collect
+#-----------------------------------------------------------------------
+
+def collect(depth, samples, input):
+        import floyd as engine
+        for n, line in enumerate(input):
+                fen = ' '.join(line.split()[0:4])
+                engine.search(fen, depth=depth, samples=samples)
+                sys.stderr.write('\rpositions %d' % (n + 1))
+        sys.stderr.write('\n')
+
+#-----------------------------------------------------------------------
+#       readSamples
+#-----------------------------------------------------------------------
+
+def readSamples(filename):
+        """Read futility samples, skipping mate scores and other record types"""
+        samples = []
+        with open(filename, 'r') as fp:
+                for line in fp:
+                        fields = line.split()
+                        if fields[0] != 'futility':
+                                continue
+                        depth, parity, eval, alpha, score = map(int, fields[1:6])
+                        features = map(int, fields[6:])
+                        if abs(score) > maxEval:
+                                continue
+                        group = baseNames[(depth, parity)]
+                        samples.append((group, eval, alpha, score, features))
+        return samples
+
+#-----------------------------------------------------------------------
+#       solve
+#-----------------------------------------------------------------------
+
+def solve(a, b):
+        """Solve a.x = b with Gaussian elimination and partial pivoting"""
+        n = len(b)
+        m = [row[:] + [b[i]] for i, row in enumerate(a)]
+        for i in range(n):
+                pivot = max(range(i, n), key=lambda r: abs(m[r][i]))
+                m[i], m[pivot] = m[pivot], m[i]
+                for r in range(i + 1, n):
+                        f = m[r][i] / m[i][i]
+                        for c in range(i, n + 1):
+                                m[r][c] -= f * m[i][c]
+        x = [0.0] * n
+        for i in reversed(range(n)):
+                x[i] = (m[i][n] - sum(m[i][c] * x[c] for c in range(i + 1, n))) / m[i][i]
+        return x
+
+#-----------------------------------------------------------------------
+#       fit
+#-----------------------------------------------------------------------
+
+def fit(samples):
+        """Least squares of search gain on the features with a constant per
+        group. Then lower each constant as far as the error rate allows."""
+        groups = sorted(set(baseNames.values()))
+        nrVars = len(groups) + len(featureNames)
+
+        def row(group, features):
+                return [float(group == g) for g in groups] + map(float, features)
+
+        ata = [[0.0] * nrVars for i in range(nrVars)]
+        atb = [0.0] * nrVars
+        for group, eval, alpha, score, features in samples:
+                x = row(group, features)
+                gain = score - eval
+                for i in range(nrVars):
+                        atb[i] += x[i] * gain
+                        for j in range(nrVars):
+                                ata[i][j] += x[i] * x[j]
+        for i in range(nrVars):
+                ata[i][i] += 1e-6 * len(samples) # Some regularization for unused features
+
+        weights = [int(round(w)) for w in solve(ata, atb)[len(groups):]]
+
+        # The margin needed to prune a node, and if that would be an error
+        needs = dict((g, []) for g in groups)
+        for group, eval, alpha, score, features in samples:
+                model = sum(w * f for w, f in zip(weights, features))
+                needs[group].append((alpha - eval - model, score > alpha))
+
+        bases = dict((g, None) for g in groups)
+        for g in groups:
+                nrPrunes = nrErrors = 0
+                for need, isError in sorted(needs[g], reverse=True):
+                        nrPrunes += 1
+                        nrErrors += isError
+                        if nrErrors <= errorRate * nrPrunes:
+                                bases[g] = need
+
+        return bases, weights
+
+#-----------------------------------------------------------------------
+#       report
+#-----------------------------------------------------------------------
+
+def report(samples, bases, weights):
+        """Show prune and error rates of the fitted model on the samples"""
+        for g in sorted(bases):
+                if bases[g] is None:
+                        continue
+                nrTests = nrPrunes = nrErrors = 0
+                for group, eval, alpha, score, features in samples:
+                        if group != g:
+                                continue
+                        margin = bases[g] + sum(w * f for w, f in zip(weights, features))
+                        nrTests += 1
+                        if eval + margin <= alpha:
+                                nrPrunes += 1
+                                nrErrors += score > alpha
+                print >>sys.stderr, '%-16s samples %7d prunes %5.1f%% errors %5.2f%%' % (
+                        g, nrTests,
+                        100.0 * nrPrunes / max(1, nrTests),
+                        100.0 * nrErrors / max(1, nrPrunes))
+
+#-----------------------------------------------------------------------
+#       main
+#-----------------------------------------------------------------------
+
+if __name__ == '__main__':
+        args = sys.argv[1:]
+
+        if len(args) == 3 and args[0] == 'collect':
+                collect(int(args[1]), args[2], sys.stdin)
+
+        elif len(args) >= 2 and args[0] == 'fit':
+                args = args[1:]
+                if args[0] == '-e':
+                        errorRate = float(args[1])
+                        args = args[2:]
+                samples = readSamples(args[0])
+                bases, weights = fit(samples)
+                report(samples, bases, weights)
+
+                vector = [[g, v] for g, v in sorted(bases.items()) if v is not None]
+                vector += [[name, w] for name, w in zip(featureNames, weights)]
+                for name, value in vector:
+                        print >>sys.stderr, 'setoption name %s value %d' % (name, value)
+                json.dump([vector, []], sys.stdout, indent=1)
+                print
+
+        else:
+                print >>sys.stderr, 'Usage: futility.py collect <depth> <samples> < positions.epd'
+                print >>sys.stderr, '       futility.py fit [-e <errorRate>] <samples> > futility.json'
+                sys.exit(1)
+
+#-----------------------------------------------------------------------
+#
+#-----------------------------------------------------------------------
+
@@ -2,9 +2,25 @@
 import floyd as engine
 import sys
 
+# Usage: nodetest.py depth [ name=value ... ] < positions.epd
+# Prints the total number of nodes per iteration and its ratio to the
+# previous iteration (to the number of positions for depth 0)
 depth = int(sys.argv[1])
+for arg in sys.argv[2:]:
+        name, value = arg.split('=')
+        engine.setSearchParameter(name, int(value))
+
+nrPositions, totals = 0, [0] * (depth + 1)
 for rawLine in sys.stdin:
-        print rawLine,
-        score, move = engine.search(rawLine, depth=depth, info='uci')
-        print
+        result = engine.search(rawLine, depth=depth)
+        nrPositions += 1
+        for d, nodes in enumerate(result.depthNodes):
+                totals[d] += nodes
+
+previous = nrPositions
+for d, nodes in enumerate(totals):
+        if nodes == 0:
+                break
+        print d, nodes, '%g' % (float(nodes) / previous)
+        previous = nodes
 
@@ -0,0 +1,189 @@
+#!/usr/bin/env python
+#-----------------------------------------------------------------------
+#
+#       replay.py -- play back a recorded UCI session
+#
+#       Usage:
+#         python replay.py [-f] [-e <engine>] <record>
+#
+#       The record is written by the engine with the `Record File' UCI
+#       option. The same input lines are fed to the engine (default
+#       ./floyd), with the original timing or, with -f, as fast as
+#       possible. In fast mode the next line waits only for the replies
+#       (`readyok' and `bestmove') that came before it in the record.
+#
+#       The replaying engine records its own session, so both sides are
+#       timed by the engine itself. For each `go' this shows the latency
+#       until `bestmove', the time target and the time used against it,
+#       and the best move, in the record and in the replay:
+#         !  time used exceeds the maximum target
+#         *  the best move is different
+#
+#-----------------------------------------------------------------------
+
+import os
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+#-----------------------------------------------------------------------
+#       Definitions
+#-----------------------------------------------------------------------
+
+syncReplies = ('readyok', 'bestmove')
+
+#-----------------------------------------------------------------------
+#       readRecord
+#-----------------------------------------------------------------------
+
+def readRecord(filename):
+        """List of (seconds, kind, text)"""
+        events = []
+        with open(filename, 'r') as fp:
+                for line in fp:
+                        fields = line.rstrip('\n').split(' ', 2)
+                        if len(fields) >= 2:
+                                events.append((float(fields[0]), fields[1], ''.join(fields[2:])))
+        return events
+
+#-----------------------------------------------------------------------
+#       searches
+#-----------------------------------------------------------------------
+
+def searches(events):
+        """Per `go': [start, latency, target, maxTarget, bestmove, command]"""
+        result, current = [], None
+        for seconds, kind, text in events:
+                if kind == '>' and text.split()[:1] == ['go']:
+                        current = [seconds, None, 0.0, 0.0, None, text]
+                        result.append(current)
+                elif kind == '#' and text.startswith('target') and current:
+                        fields = text.split()
+                        current[2], current[3] = float(fields[2]), float(fields[4])
+                elif kind == '<' and text.startswith('bestmove') and current and current[1] is None:
+                        current[1] = seconds - current[0]
+                        current[4] = text.split()[1]
+        return result
+
+#-----------------------------------------------------------------------
+#       replay
+#-----------------------------------------------------------------------
+
+def replay(command, events, fast, newRecord):
+        p = subprocess.Popen([command], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        def send(line):
+                p.stdin.write(line + '\n')
+                p.stdin.flush()
+
+        # Count the synchronizing replies as they come in
+        counts = dict((reply, 0) for reply in syncReplies)
+        cond = threading.Condition()
+        def reader():
+                for line in iter(p.stdout.readline, ''):
+                        for reply in syncReplies:
+                                if line.startswith(reply):
+                                        with cond:
+                                                counts[reply] += 1
+                                                cond.notify()
+        thread = threading.Thread(target=reader)
+        thread.daemon = True
+        thread.start()
+
+        def waitFor(reply, n):
+                with cond:
+                        while counts[reply] < n:
+                                cond.wait(1.0)
+
+        # The recorded options, and a record of our own
+        for seconds, kind, text in events:
+                if kind == '#' and text.startswith('option '):
+                        send('setoption ' + text[len('option '):])
+        send('setoption name Record File value ' + newRecord)
+        send('isready')
+        waitFor('readyok', 1)
+
+        inputs = [e for e in events if e[1] == '>']
+        startRecord = inputs[0][0] if inputs else 0.0
+        startReplay = time.time()
+        expected = dict((reply, 1 if reply == 'readyok' else 0) for reply in syncReplies)
+
+        for seconds, kind, text in events:
+                if seconds < startRecord:
+                        continue # Replies from before the recording started
+                if kind == '<':
+                        for reply in syncReplies:
+                                if text.startswith(reply):
+                                        expected[reply] += 1
+                if kind != '>':
+                        continue
+                if text.startswith('setoption name Record File'):
+                        continue # Keep our own
+                if fast:
+                        for reply in syncReplies:
+                                waitFor(reply, expected[reply])
+                else:
+                        delay = startReplay + (seconds - startRecord) - time.time()
+                        if delay > 0.0:
+                                time.sleep(delay)
+                send(text)
+                if text.split()[:1] == ['quit']:
+                        break
+        else:
+                send('quit')
+        p.wait()
+
+#-----------------------------------------------------------------------
+#       main
+#-----------------------------------------------------------------------
+
+if __name__ == '__main__':
+        args, fast, command = sys.argv[1:], False, './floyd'
+        while len(args) > 0 and args[0][0] == '-':
+                if args[0] == '-f':
+                        fast, args = True, args[1:]
+                elif args[0] == '-e' and len(args) >= 2:
+                        command, args = args[1], args[2:]
+                else:
+                        args = []
+        if len(args) != 1:
+                print >>sys.stderr, 'Usage: replay.py [-f] [-e <engine>] <record>'
+                sys.exit(1)
+
+        events = readRecord(args[0])
+        fd, newRecord = tempfile.mkstemp(suffix='.rec')
+        os.close(fd)
+        try:
+                replay(command, events, fast, newRecord)
+                newEvents = readRecord(newRecord)
+        finally:
+                os.unlink(newRecord)
+
+        old, new = searches(events), searches(newEvents)
+        print '%3s %9s %9s %8s %8s %7s %-7s %-7s  %s' % ('go', 'latency', 'replay',
+                'target', 'max', 'used', 'move', 'replay', 'command')
+        nrOver, nrDiverged = 0, 0
+        for i, (a, b) in enumerate(map(None, old, new)):
+                a = a or [None, None, 0.0, 0.0, None, '']
+                b = b or [None, None, 0.0, 0.0, None, '']
+                over = any(s[1] is not None and s[3] > 0.0 and s[1] > s[3] for s in (a, b))
+                diverged = a[4] != b[4]
+                nrOver += over
+                nrDiverged += diverged
+                fmt = lambda x: '%9.3f' % x if x is not None else '%9s' % '-'
+                used = '%6.0f%%' % (100.0 * b[1] / b[2]) if b[1] is not None and b[2] > 0.0 else '%7s' % '-'
+                print '%3d %s %s %8.3f %8.3f %s %-7s %-7s%s%s %s' % (i + 1, fmt(a[1]), fmt(b[1]),
+                        b[2] or a[2], b[3] or a[3], used, a[4] or '-', b[4] or '-',
+                        '!' if over else ' ', '*' if diverged else ' ', a[5] or b[5])
+
+        latencies = sorted(b[1] for b in new if b[1] is not None)
+        if latencies:
+                print 'replay latency median %.3f max %.3f' % (
+                        latencies[len(latencies) // 2], latencies[-1])
+        print 'searches %d overtime %d diverged %d' % (max(len(old), len(new)), nrOver, nrDiverged)
+
+#-----------------------------------------------------------------------
+#
+#-----------------------------------------------------------------------
+
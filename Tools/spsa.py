@@ -0,0 +1,229 @@
+#!/usr/bin/env python
+#-----------------------------------------------------------------------
+#
+#       spsa.py -- tune search parameters by self-play
+#
+#       Usage:
+#         python spsa.py [<option> ...] <state.json> [<parameter> ...] < openings.epd
+#
+#       Simultaneous perturbation stochastic approximation (SPSA): each
+#       step shifts all parameters at once by +c or -c at random, plays a
+#       game pair between the two shifted sets from the same opening (one
+#       game with each color) and moves the parameters along the result.
+#       The games are played in-process with floyd.selfPlay, one thread
+#       per core, each with its own evaluation vector.
+#
+#       The state file keeps the parameters and the step count, so runs
+#       can be continued. It is written as JSON for updateDefaults.py:
+#         python Tools/updateDefaults.py spsa.json < Source/params.h
+#       Without parameter names, the continuous parameters with a non-zero
+#       default are tuned. That leaves out the zero-valued terms, the
+#       entries of the monotone delta table, and the switches. Switches are
+#       the parameters marked `(0 = off)' in params.h, and these are never
+#       perturbed, not even when named.
+#
+#       Options:
+#         -n <threads>  Parallel games (default cpu count)
+#         -N <nodes>    Nodes per move (default 1000)
+#         -i <pairs>    Game pairs to play in this run (default 10000)
+#         -r <rate>     Learning rate at the end of the schedule (default 0.002)
+#         -c <fraction> Perturbation as a fraction of the value (default 0.1, minimum 1)
+#
+#-----------------------------------------------------------------------
+
+import floyd as engine
+import json
+import multiprocessing
+import Queue
+import random
+import re
+import sys
+import threading
+
+#-----------------------------------------------------------------------
+#       Options
+#-----------------------------------------------------------------------
+
+nrThreads = multiprocessing.cpu_count() # -n
+nodes = 1000                            # -N
+nrPairs = 10000                         # -i
+endRate = 0.002                         # -r
+cFraction = 0.1                         # -c
+
+# Schedule exponents and stability constant, as recommended by Spall
+alpha = 0.602
+gamma = 0.101
+stability = 0.1 # Times the number of pairs
+
+# Print the parameters after this many pairs
+reportInterval = 100
+
+# Entries of the delta pruning table, tuned by Tools/delta.py instead
+tablePattern = r'deltaPhase\d_\d$'
+
+#-----------------------------------------------------------------------
+#       Parameters
+#-----------------------------------------------------------------------
+
+def readSwitches(filename):
+        """Names of the parameters that params.h marks with `(0 = off)'"""
+        with open(filename, 'r') as fp:
+                return set(re.findall(r'P\((\w+), *-?\d+\),.*\(0 = off\)', fp.read()))
+
+switches = readSwitches('Source/params.h')
+
+def defaultActive():
+        """Continuous parameters with a non-zero default"""
+        return [name for name in engine.searchLabels
+                if name not in switches and not re.match(tablePattern, name)
+                and engine.getSearchParameter(name) != 0]
+
+#-----------------------------------------------------------------------
+#       State
+#-----------------------------------------------------------------------
+
+def readState(filename):
+        """Return (params, history) with params a list of [name, value, c]"""
+        try:
+                with open(filename, 'r') as fp:
+                        asList, history = json.load(fp)
+                params = [[name, exact, c] for name, value, c, exact in asList]
+        except IOError as err:
+                print err
+                print 'continuing'
+                params = [[name, float(engine.getSearchParameter(name)), None] for name in engine.searchLabels]
+                history = []
+        for item in params:
+                if item[2] is None:
+                        item[2] = max(1.0, abs(item[1]) * cFraction)
+                if item[0] in switches:
+                        item[2] = 0.0 # Never perturbed
+        return params, history
+
+def writeState(filename, params, history):
+        """Rounded values for updateDefaults.py, exact ones to continue from"""
+        with open(filename, 'w') as fp:
+                asList = [[name, int(round(value)), c, value] for name, value, c in params]
+                json.dump((asList, history), fp, indent=1, separators=(',', ':'))
+                fp.write('\n')
+
+#-----------------------------------------------------------------------
+#       Games
+#-----------------------------------------------------------------------
+
+scores = { '1-0': 1.0, '1/2-1/2': 0.5, '0-1': 0.0 }
+
+def playPair(fen, plus, minus, vector):
+        """Score of `plus' against `minus' in two games: -1.0 .. +1.0"""
+        result1, moves = engine.selfPlay(fen, white=plus, black=minus, nodes=nodes, vector=vector)
+        result2, moves = engine.selfPlay(fen, white=minus, black=plus, nodes=nodes, vector=vector)
+        return scores[result1] - scores[result2]
+
+def runThread(tasks, results):
+        vector = engine.Vector() # Own caches, so the threads don't wait for each other
+        while True:
+                k, fen, plus, minus, delta = tasks.get()
+                results.put((k, delta, playPair(fen, plus, minus, vector)))
+
+#-----------------------------------------------------------------------
+#       spsa
+#-----------------------------------------------------------------------
+
+def spsa(params, active, history, openings):
+        """Asynchronous SPSA: each result updates the parameters right away,
+        and the next pair starts from there. Only the `active' ones change."""
+        k0 = history[-1][0] if history else 0 # Continue the schedule
+        end = k0 + nrPairs
+        A = stability * end
+
+        def gains(k, c):
+                # ak and ck for step k, such that ak / ck^2 = endRate at the end
+                ck = c * (float(end) / k) ** gamma
+                ak = endRate * c * c * ((A + end) / (A + k)) ** alpha
+                return ak, ck
+
+        tasks, results = Queue.Queue(), Queue.Queue()
+        for i in range(nrThreads):
+                thread = threading.Thread(target=runThread, args=(tasks, results))
+                thread.daemon = True
+                thread.start()
+
+        def newTask(k):
+                delta = [random.choice((-1, 1)) if item[0] in active and item[2] > 0.0 else 0
+                         for item in params]
+                plus, minus = {}, {}
+                for (name, value, c), d in zip(params, delta):
+                        ak, ck = gains(k, c)
+                        plus[name] = max(0, int(round(value + ck * d)))
+                        minus[name] = max(0, int(round(value - ck * d)))
+                tasks.put((k, random.choice(openings), plus, minus, delta))
+
+        k = k0
+        while k < min(k0 + nrThreads, end):
+                k += 1
+                newTask(k)
+
+        done, sumScore = 0, 0.0
+        try:
+                while done < nrPairs:
+                        kTask, delta, score = results.get(timeout=1e9) # With timeout to allow ^C
+                        for item, d in zip(params, delta):
+                                if d != 0:
+                                        ak, ck = gains(kTask, item[2])
+                                        item[1] = max(0.0, item[1] + ak * score * d / ck)
+                        done += 1
+                        sumScore += score
+                        if k < end:
+                                k += 1
+                                newTask(k)
+                        if done % reportInterval == 0:
+                                report(k0 + done, sumScore / done, params, active)
+        except KeyboardInterrupt:
+                print 'interrupted'
+
+        if done > 0:
+                if done % reportInterval != 0:
+                        report(k0 + done, sumScore / done, params, active)
+                history.append([k0 + done, [[name, round(value, 2)] for name, value, c in params
+                                            if name in active]])
+
+def report(k, meanScore, params, active):
+        print 'pairs %d score %+.3f' % (k, meanScore),
+        print ' '.join('%s %.1f' % (name, value) for name, value, c in params if name in active)
+        sys.stdout.flush()
+
+#-----------------------------------------------------------------------
+#       main
+#-----------------------------------------------------------------------
+
+if __name__ == '__main__':
+        args = sys.argv[1:]
+        while len(args) >= 2 and args[0][0] == '-':
+                option, value, args = args[0], args[1], args[2:]
+                if   option == '-n': nrThreads = int(value)
+                elif option == '-N': nodes = int(value)
+                elif option == '-i': nrPairs = int(value)
+                elif option == '-r': endRate = float(value)
+                elif option == '-c': cFraction = float(value)
+                else: args = []
+        if len(args) < 1:
+                print >>sys.stderr, 'Usage: spsa.py [<option> ...] <state.json> [<parameter> ...] < openings.epd'
+                sys.exit(1)
+
+        filename = args[0]
+        params, history = readState(filename)
+        active = args[1:] or defaultActive()
+        for name in active:
+                engine.getSearchParameter(name) # Raises KeyError for unknown names
+        active = [name for name in active if name not in switches]
+        openings = [' '.join(line.split()[0:4]) for line in sys.stdin if line.strip()]
+
+        print 'state %s parameters %d threads %d nodes %d pairs %d' % (
+                repr(filename), len(active), nrThreads, nodes, nrPairs)
+        spsa(params, active, history, openings)
+        writeState(filename, params, history)
+
+#-----------------------------------------------------------------------
+#
+#-----------------------------------------------------------------------
+
@@ -0,0 +1,102 @@
+#!/usr/bin/env python
+#-----------------------------------------------------------------------
+#
+#       ttcompare.py -- compare transposition table replacement policies
+#
+#       Usage:
+#         python ttcompare.py [-d <depth>] [-p <plies>] [<engine> [<hash> ...]]
+#
+#       Plays through a self-play game with the UCI engine (default
+#       ./floyd) and searches each position to a fixed depth, keeping
+#       the hash table as in a real game. This is repeated for each
+#       `Hash Policy' and hash size in MB (default 1 4 16 64). Shows the
+#       time to depth and the hit rate and evictions from `stats'.
+#
+#-----------------------------------------------------------------------
+
+import floyd as engine
+import re
+import subprocess
+import sys
+import time
+
+#-----------------------------------------------------------------------
+#       Definitions
+#-----------------------------------------------------------------------
+
+policies = ['age', 'twotier']
+startpos = 'rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -'
+
+depth = 10 # -d
+plies = 60 # -p
+
+#-----------------------------------------------------------------------
+#       runGame
+#-----------------------------------------------------------------------
+
+def runGame(command, policy, hashSize, moves):
+        """Return (seconds, probes, hits, evictions) summed over the game"""
+        p = subprocess.Popen([command], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        def send(line):
+                p.stdin.write(line + '\n')
+                p.stdin.flush()
+        def waitFor(prefix):
+                lines = []
+                while True:
+                        line = p.stdout.readline()
+                        lines.append(line)
+                        if line.startswith(prefix):
+                                return lines
+
+        send('setoption name Hash value %d' % hashSize)
+        send('setoption name Hash Policy value %s' % policy)
+        send('isready')
+        waitFor('readyok')
+
+        seconds, probes, hits, evictions = 0.0, 0, 0, 0
+        for ply in range(len(moves)):
+                send('position startpos moves %s' % ' '.join(moves[:ply]))
+                start = time.time()
+                send('go depth %d' % depth)
+                waitFor('bestmove')
+                seconds += time.time() - start
+                send('stats')
+                send('isready')
+                for line in waitFor('readyok'):
+                        match = re.search(r'ttprobes (\d+) tthits (\d+) ttstores \d+ ttevictions (\d+)', line)
+                        if match:
+                                probes += int(match.group(1))
+                                hits += int(match.group(2))
+                                evictions += int(match.group(3))
+        send('quit')
+        p.wait()
+        return seconds, probes, hits, evictions
+
+#-----------------------------------------------------------------------
+#       main
+#-----------------------------------------------------------------------
+
+if __name__ == '__main__':
+        args = sys.argv[1:]
+        while len(args) >= 2 and args[0] in ('-d', '-p'):
+                if args[0] == '-d': depth = int(args[1])
+                if args[0] == '-p': plies = int(args[1])
+                args = args[2:]
+        command = args[0] if args else './floyd'
+        hashSizes = map(int, args[1:]) or [1, 4, 16, 64]
+
+        result, moves = engine.selfPlay(startpos, nodes=10000, maxPlies=plies)
+
+        print 'positions %d depth %d' % (len(moves), depth)
+        print '%-8s %6s %9s %8s %10s' % ('policy', 'hash', 'seconds', 'hits', 'evictions')
+        for hashSize in hashSizes:
+                for policy in policies:
+                        seconds, probes, hits, evictions = runGame(command, policy, hashSize, moves)
+                        print '%-8s %6d %9.3f %7.2f%% %10d' % (
+                                policy, hashSize, seconds, 100.0 * hits / max(1, probes), evictions)
+                        sys.stdout.flush()
+
+#-----------------------------------------------------------------------
+#
+#-----------------------------------------------------------------------
+
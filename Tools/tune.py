@@ -61,18 +61,7 @@ def readTestsFromEpd(input):
 #-----------------------------------------------------------------------
 
 def getVector():
-        vector, names = [], []
-        try:
-                coef = 0
-                while True:
-                        value, id = engine.setCoefficient(coef, 0)
-                        engine.setCoefficient(coef, value) # TODO: HACK
-                        vector.append(value)
-                        names.append(id)
-                        coef += 1
-        except IndexError:
-                pass
-        return vector, names
+        return list(engine.Vector()), list(engine.vectorLabels)
 
 #-----------------------------------------------------------------------
 #       evaluateVector